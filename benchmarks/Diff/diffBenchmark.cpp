@@ -0,0 +1,203 @@
+#include "yatta.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+
+// Convenience Definitions
+using yatta::Buffer;
+using DiffOptions = yatta::Buffer::DiffOptions;
+using Clock = std::chrono::steady_clock;
+
+// Forward Declarations
+Buffer Diff_MakeSource(const size_t& size);
+Buffer Diff_MakeTarget(const Buffer& source);
+Buffer Diff_ReadFile(const std::string& path);
+void Diff_Presets(
+    const std::string& name, const Buffer& source, const Buffer& target);
+void Diff_Sweep(
+    const std::string& name, const Buffer& source, const Buffer& target);
+void Diff_Benchmark(
+    const std::string& name, const Buffer& source, const Buffer& target,
+    const DiffOptions& options);
+
+// Count every heap allocation, so patches can report how many they make
+std::atomic_size_t Allocations = 0ULL;
+void* operator new(std::size_t size) {
+    ++Allocations;
+    if (auto* const ptr = std::malloc(size == 0ULL ? 1ULL : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t /*unused*/) noexcept {
+    std::free(ptr);
+}
+
+// A small pseudo-random generator, so every run uses the same data
+struct Random {
+    size_t m_state = 1234ULL;
+    size_t next() noexcept {
+        m_state = (m_state * 6364136223846793005ULL) + 1442695040888963407ULL;
+        return m_state >> 33ULL;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    // Benchmark the supplied files, or synthesized binaries of various sizes
+    if (argc == 3) {
+        const auto source = Diff_ReadFile(argv[1]);
+        const auto target = Diff_ReadFile(argv[2]);
+        Diff_Presets(argv[2], source, target);
+        Diff_Sweep(argv[2], source, target);
+        exit(0);
+    }
+    for (const auto& megabytes : { 1ULL, 16ULL, 64ULL }) {
+        const auto source = Diff_MakeSource(megabytes * 1048576ULL);
+        Diff_Presets(
+            std::to_string(megabytes) + "MB binary", source,
+            Diff_MakeTarget(source));
+    }
+
+    // Sweep the tuning options on a mid-sized binary
+    const auto source = Diff_MakeSource(16ULL * 1048576ULL);
+    Diff_Sweep("16MB binary", source, Diff_MakeTarget(source));
+    exit(0);
+}
+
+Buffer Diff_MakeSource(const size_t& size) {
+    // Mix code-like noise, small integer tables, and repeated strings
+    Random random;
+    Buffer buffer;
+    buffer.reserve(size);
+    constexpr char text[] = "yatta::Buffer::diff(const MemoryRange&)";
+    while (buffer.size() < size) {
+        const auto section = random.next() % 3ULL;
+        for (size_t x = 0ULL; x < 256ULL; ++x) {
+            if (section == 0ULL)
+                buffer.push_type(static_cast<std::byte>(random.next()));
+            else if (section == 1ULL)
+                buffer.push_type(static_cast<std::byte>(random.next() % 8ULL));
+            else
+                buffer.push_type(
+                    static_cast<std::byte>(text[x % (sizeof(text) - 1ULL)]));
+        }
+    }
+    buffer.resize(size);
+    return buffer;
+}
+
+Buffer Diff_MakeTarget(const Buffer& source) {
+    // Insert new bytes every 256KB, and overwrite some bytes every 64KB,
+    // shifting everything after them
+    Random random;
+    Buffer buffer;
+    buffer.reserve(source.size() + (source.size() / 4096ULL));
+    for (size_t index = 0ULL; index < source.size(); index += 65536ULL) {
+        const auto length = std::min<size_t>(65536ULL, source.size() - index);
+        const auto offset = buffer.size();
+        buffer.push_raw(&source[index], length);
+        for (size_t x = 0ULL; x < std::min<size_t>(16ULL, length); ++x)
+            buffer[offset + x] = static_cast<std::byte>(random.next());
+        if ((index % 262144ULL) == 0ULL)
+            for (size_t x = 0ULL, count = 8ULL + (random.next() % 56ULL);
+                 x < count; ++x)
+                buffer.push_type(static_cast<std::byte>(random.next()));
+    }
+    return buffer;
+}
+
+Buffer Diff_ReadFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    Buffer buffer(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(
+        reinterpret_cast<char*>(buffer.bytes()),
+        static_cast<std::streamsize>(buffer.size()));
+    return buffer;
+}
+
+void Diff_Presets(
+    const std::string& name, const Buffer& source, const Buffer& target) {
+    Diff_Benchmark(name + " (fast)", source, target, DiffOptions::Fast());
+    Diff_Benchmark(
+        name + " (balanced)", source, target, DiffOptions::Balanced());
+    Diff_Benchmark(
+        name + " (max ratio)", source, target, DiffOptions::MaxRatio());
+}
+
+void Diff_Sweep(
+    const std::string& name, const Buffer& source, const Buffer& target) {
+    // Vary one option at a time away from the balanced preset
+    for (const auto& windowSize : { 1024ULL, 4096ULL, 16384ULL, 65536ULL }) {
+        auto options = DiffOptions::Balanced();
+        options.m_windowSize = windowSize;
+        Diff_Benchmark(
+            name + " (window " + std::to_string(windowSize) + ")", source,
+            target, options);
+    }
+    for (const auto& minMatch : { 16ULL, 32ULL, 64ULL, 128ULL }) {
+        auto options = DiffOptions::Balanced();
+        options.m_minMatch = minMatch;
+        Diff_Benchmark(
+            name + " (min match " + std::to_string(minMatch) + ")", source,
+            target, options);
+    }
+    for (const auto& searchDepth : { 1ULL, 4ULL, 16ULL, 64ULL }) {
+        auto options = DiffOptions::Balanced();
+        options.m_searchDepth = searchDepth;
+        Diff_Benchmark(
+            name + " (search depth " + std::to_string(searchDepth) + ")",
+            source, target, options);
+    }
+    for (const auto& threadCount : { 1ULL, 2ULL, 4ULL }) {
+        auto options = DiffOptions::Balanced();
+        options.m_threadCount = threadCount;
+        Diff_Benchmark(
+            name + " (" + std::to_string(threadCount) + " threads)", source,
+            target, options);
+    }
+    for (const auto& memoryBudget : { 1048576ULL, 16777216ULL }) {
+        auto options = DiffOptions::Balanced();
+        options.m_memoryBudget = memoryBudget;
+        Diff_Benchmark(
+            name + " (budget " + std::to_string(memoryBudget >> 20ULL) +
+                "MB)",
+            source, target, options);
+    }
+}
+
+void Diff_Benchmark(
+    const std::string& name, const Buffer& source, const Buffer& target,
+    const DiffOptions& options) {
+    // Time how long the diff takes
+    const auto start = Clock::now();
+    const auto diffBuffer = source.diff(target, options);
+    const auto seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    if (!diffBuffer.has_value()) {
+        std::cout << name << ": diff failed\n";
+        return;
+    }
+
+    // Time how long the patch takes, and ensure the diff is valid
+    const auto patchAllocations = Allocations.load();
+    const auto patchStart = Clock::now();
+    const auto patchedBuffer = source.patch(*diffBuffer);
+    const auto patchSeconds =
+        std::chrono::duration<double>(Clock::now() - patchStart).count();
+    const auto allocations = Allocations.load() - patchAllocations;
+    const auto valid =
+        patchedBuffer.has_value() && patchedBuffer->hash() == target.hash();
+
+    // Report throughput over the target size, and the patch size
+    const auto megabytes = static_cast<double>(target.size()) / 1048576.0;
+    std::cout << name << ": " << megabytes << " MB in " << seconds * 1000.0
+              << " ms (" << megabytes / seconds << " MB/s), patch "
+              << diffBuffer->size() << " bytes, applied in "
+              << patchSeconds * 1000.0 << " ms with " << allocations
+              << " allocations"
+              << (valid ? "" : ", PATCH MISMATCH") << '\n';
+}
\ No newline at end of file
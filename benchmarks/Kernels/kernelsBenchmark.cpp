@@ -0,0 +1,79 @@
+#include "yatta.hpp"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Convenience Definitions
+using yatta::Kernels;
+using InstructionSet = yatta::Kernels::InstructionSet;
+using Clock = std::chrono::steady_clock;
+
+// Forward Declarations
+std::string Kernels_Name(const InstructionSet& instructionSet);
+template <typename Kernel>
+void Kernels_Benchmark(
+    const std::string& name, const size_t& length, const Kernel& kernel);
+
+int main() {
+    // Compare equal ranges in full, as long matches and runs do when diffing
+    const std::vector<std::byte> bytesA(1048576ULL, std::byte{ 0xAB });
+    const std::vector<std::byte> bytesB(bytesA);
+    const auto end = bytesA.size();
+    for (const auto& instructionSet :
+         { InstructionSet::SCALAR, InstructionSet::SSE2, InstructionSet::AVX2,
+           InstructionSet::AVX512 }) {
+        const auto table = Kernels::table(instructionSet);
+        if (!table) {
+            std::cout << Kernels_Name(instructionSet) << ": unsupported\n";
+            continue;
+        }
+        for (const auto& length : { 64ULL, 4096ULL, 1048576ULL }) {
+            const auto name =
+                Kernels_Name(instructionSet) + " " + std::to_string(length);
+            Kernels_Benchmark(name + "B prefix", length, [&]() {
+                return table->m_commonPrefix(
+                    bytesA.data(), bytesB.data(), length);
+            });
+            Kernels_Benchmark(name + "B suffix", length, [&]() {
+                return table->m_commonSuffix(
+                    &bytesA.data()[end], &bytesB.data()[end], length);
+            });
+            Kernels_Benchmark(name + "B run", length, [&]() {
+                return table->m_runLength(bytesA.data(), bytesA[0], length);
+            });
+        }
+    }
+    exit(0);
+}
+
+std::string Kernels_Name(const InstructionSet& instructionSet) {
+    switch (instructionSet) {
+    case InstructionSet::SSE2:
+        return "SSE2";
+    case InstructionSet::AVX2:
+        return "AVX2";
+    case InstructionSet::AVX512:
+        return "AVX-512";
+    default:
+        return "Scalar";
+    }
+}
+
+template <typename Kernel>
+void Kernels_Benchmark(
+    const std::string& name, const size_t& length, const Kernel& kernel) {
+    // Repeat the kernel over roughly 4GB, checking it measured every byte
+    const auto iterations = (4ULL * 1073741824ULL) / length;
+    size_t total(0ULL);
+    const auto start = Clock::now();
+    for (size_t x = 0ULL; x < iterations; ++x)
+        total += kernel();
+    const auto seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << name << ": "
+              << (static_cast<double>(iterations * length) / seconds /
+                  1073741824.0)
+              << " GB/s" << (total == iterations * length ? "" : " (wrong)")
+              << "\n";
+}
\ No newline at end of file
@@ -1,161 +1,166 @@
 #include "buffer.hpp"
-#include "lz4/lz4.h"
+#include "kernels.hpp"
 #include "threader.hpp"
 #include <algorithm>
 #include <climits>
+#include <cstdint>
 #include <cstring>
+#include <iterator>
 #include <numeric>
 #include <vector>
 
 // Convenience Definitions
 using yatta::Buffer;
+using yatta::Codec;
+using yatta::Kernels;
 using yatta::MemoryRange;
 using yatta::Threader;
-
+using DiffMode = yatta::Buffer::DiffMode;
+using DiffOptions = yatta::Buffer::DiffOptions;
+
+/** Ranges at least this large are probed for incompressible data. */
+constexpr size_t EntropyProbeSize = 4096ULL;
+/** Sampled entropy above which data is considered incompressible. */
+constexpr double IncompressibleEntropy = 7.9;
+/** Size of the block compressed to confirm data looks incompressible. */
+constexpr size_t CompressionProbeSize = 65536ULL;
 /** Data structures for buffer compression headers. */
 struct CompressionHeader {
     char m_title[16ULL] = { '\0' };
     size_t m_uncompressedSize = 0ULL;
+    size_t m_codecTag = 0ULL;
+};
+/** Data structures for buffer compression headers, prior to codec tags. */
+struct LegacyCompressionHeader {
+    char m_title[16ULL] = { '\0' };
+    size_t m_uncompressedSize = 0ULL;
+};
+/** Data structures for seekable buffer compression headers. */
+struct SeekableHeader {
+    char m_title[16ULL] = { '\0' };
+    size_t m_uncompressedSize = 0ULL;
+    size_t m_blockSize = 0ULL;
+    size_t m_blockCount = 0ULL;
 };
+/** The number of instruction bytes per block of a large diff, bounding the
+memory a streaming patch expands at once. */
+constexpr size_t PatchBlockSize = 262144ULL;
+/** The fewest target bytes each job of a parallel patch writes. */
+constexpr size_t PatchJobSize = 1048576ULL;
+/** The most target bytes staged before reaching a streaming patch's sink. */
+constexpr size_t PatchStageSize = 65536ULL;
 /** Data structures for buffer differential headers. */
 struct DifferentialHeader {
     char m_title[16ULL] = { '\0' };
     size_t m_targetSize = 0ULL;
 };
-/** Super-class for buffer diff instructions. */
-struct Differential_Instruction {
-    // Public Default Members
-    virtual ~Differential_Instruction() = default;
-    Differential_Instruction() = default;
-    Differential_Instruction(const Differential_Instruction& other) = default;
-    Differential_Instruction(Differential_Instruction&& other) = default;
-    Differential_Instruction&
-    operator=(const Differential_Instruction& other) = default;
-    Differential_Instruction&
-    operator=(Differential_Instruction&& other) = default;
-    // Interface Declaration
-    /** Retrieve the byte-size of this instruction. */
-    [[nodiscard]] virtual size_t size() const noexcept = 0;
-    /** Execute this instruction. */
-    virtual void
-    execute(Buffer& bufferNew, const MemoryRange& bufferOld) const = 0;
-    /** Write-out this instruction to a buffer. */
-    virtual void write(Buffer& outputBuffer) const = 0;
-    /** Read-in this instruction from a buffer. */
-    virtual void read(const Buffer& inputBuffer, size_t& byteIndex) = 0;
-
-    // Attributes
-    size_t m_index = 0ULL;
-};
-/** Diff instruction to copy an existing segment. */
-struct Copy_Instruction final : public Differential_Instruction {
-    // Interface Implementation
-    [[nodiscard]] size_t size() const noexcept final {
-        return static_cast<size_t>(sizeof(char) + (sizeof(size_t) * 3ULL));
-    }
-    void execute(Buffer& bufferNew, const MemoryRange& bufferOld) const final {
-        const auto old_subRange =
-            bufferOld.subrange(m_beginRead, m_endRead - m_beginRead);
-        std::copy(
-            old_subRange.cbegin(), old_subRange.cend(), &bufferNew[m_index]);
-    }
-    void write(Buffer& outputBuffer) const final {
-        // Write Attributes
-        outputBuffer.push_type('C');
-        outputBuffer.push_type(m_index);
-        outputBuffer.push_type(m_beginRead);
-        outputBuffer.push_type(m_endRead);
-    }
-    void read(const Buffer& inputBuffer, size_t& byteIndex) final {
-        // Read Attributes
-        // Type already read
-        inputBuffer.out_type(m_index, byteIndex);
-        byteIndex += sizeof(size_t);
-        inputBuffer.out_type(m_beginRead, byteIndex);
-        byteIndex += sizeof(size_t);
-        inputBuffer.out_type(m_endRead, byteIndex);
-        byteIndex += sizeof(size_t);
-    }
-
-    // Public Attributes
-    size_t m_beginRead = 0ULL, m_endRead = 0ULL;
+/** The largest number of bytes a LEB128 encoded size_t may occupy. */
+constexpr size_t MaxVarintSize = ((sizeof(size_t) * CHAR_BIT) + 6ULL) / 7ULL;
+/** Write an unsigned integer as a LEB128 varint. */
+void push_varint(Buffer& outputBuffer, size_t value) {
+    while (value >= 0x80ULL) {
+        outputBuffer.push_type(static_cast<std::byte>(value | 0x80ULL));
+        value >>= 7ULL;
+    }
+    outputBuffer.push_type(static_cast<std::byte>(value));
+}
+/** Zigzag encode the signed distance from a base offset to a value. */
+constexpr size_t
+zigzag_encode(const size_t& value, const size_t& base) noexcept {
+    const auto delta = value - base;
+    return (delta << 1ULL) ^
+           (0ULL - (delta >> ((sizeof(size_t) * CHAR_BIT) - 1ULL)));
+}
+/** Decode a zigzag encoded distance, returning the value it leads to. */
+constexpr size_t
+zigzag_decode(const size_t& encoded, const size_t& base) noexcept {
+    return base + ((encoded >> 1ULL) ^ (0ULL - (encoded & 1ULL)));
+}
+/** Write the signed distance from a base offset to a value as a varint. */
+void push_offset(
+    Buffer& outputBuffer, const size_t& value, const size_t& base) {
+    push_varint(outputBuffer, zigzag_encode(value, base));
+}
+/** Positions carried between instructions of a varint encoded diff. */
+struct Differential_Cursor {
+    /** Where the previous instruction ended in the target. */
+    size_t m_targetEnd = 0ULL;
+    /** Where the previous copy or addition ended in the source. */
+    size_t m_sourceEnd = 0ULL;
 };
-/** Diff instruction for inserting an entirely new data segment. */
-struct Insert_Instruction final : public Differential_Instruction {
-    // Interface Implementation
-    [[nodiscard]] size_t size() const noexcept final {
-        return static_cast<size_t>(
-            sizeof(char) + (sizeof(size_t) * 2ULL) +
-            (sizeof(char) * m_newData.size()));
-    }
-    void execute(Buffer& bufferNew, const MemoryRange& /*unused*/) const final {
-        std::copy(m_newData.cbegin(), m_newData.cend(), &bufferNew[m_index]);
-    }
-    void write(Buffer& outputBuffer) const final {
-        // Write Attributes
-        outputBuffer.push_type('I');
-        outputBuffer.push_type(m_index);
-        const auto length = m_newData.size();
-        outputBuffer.push_type(length);
-        if (length != 0U)
-            outputBuffer.push_raw(m_newData.data(), length);
-    }
-    void read(const Buffer& inputBuffer, size_t& byteIndex) final {
-        // Read Attributes
-        // Type already read
-        inputBuffer.out_type(m_index, byteIndex);
-        byteIndex += sizeof(size_t);
-        size_t length(0ULL);
-        inputBuffer.out_type(length, byteIndex);
-        byteIndex += sizeof(size_t);
-        if (length != 0ULL) {
-            m_newData.resize(length);
-            inputBuffer.out_raw(m_newData.data(), length, byteIndex);
-            byteIndex += sizeof(char) * length;
-        }
-    }
-
-    // Attributes
-    std::vector<std::byte> m_newData;
+/** Add byte-wise differences onto a source range, writing the sums out.
+The output may alias the differences, but mustn't overlap the source. */
+void add_differences(
+    std::byte* const outputBytes, const std::byte* const sourceBytes,
+    const std::byte* const deltaBytes, const size_t& length) noexcept {
+    for (size_t x = 0ULL; x < length; ++x)
+        outputBytes[x] = static_cast<std::byte>(
+            static_cast<unsigned char>(sourceBytes[x]) +
+            static_cast<unsigned char>(deltaBytes[x]));
+}
+/** A diff instruction as generated by the differ, without any data of its
+own. Inserted data and repeated patterns are read straight from the target,
+and byte-wise differences from the literal pool of the instruction set. */
+struct Instruction_Record {
+    /** The instruction type, one of 'C', 'I', 'R', 'P', or 'A'. */
+    char m_type = 'I';
+    /** The pattern length of 'R' and 'P' instructions. */
+    size_t m_period = 0ULL;
+    /** The target range this instruction writes to. */
+    size_t m_index = 0ULL, m_length = 0ULL;
+    /** The source offset read by 'C' and 'A' instructions. */
+    size_t m_beginRead = 0ULL;
+    /** The literal pool offset of the differences of 'A' instructions. */
+    size_t m_literal = 0ULL;
+    /** The base read by 'C' and 'A' instructions of multi-base diffs. */
+    size_t m_base = 0ULL;
 };
-/** Diff instruction for a repeating value. */
-struct Repeat_Instruction final : public Differential_Instruction {
-    // Interface Implementation
-    [[nodiscard]] size_t size() const noexcept final {
-        return static_cast<size_t>(
-            sizeof(char) + (sizeof(size_t) * 2ULL) + sizeof(char));
-    }
-    void execute(Buffer& bufferNew, const MemoryRange& /*unused*/) const final {
-        std::fill(
-            &bufferNew[m_index],
-            &bufferNew[std::min(m_index + m_amount, bufferNew.size())],
-            m_value);
-    }
-    void write(Buffer& outputBuffer) const final {
-        // Write Attributes
-        outputBuffer.push_type('R');
-        // Write Index
-        outputBuffer.push_type(m_index);
-        // Write Amount
-        outputBuffer.push_type(m_amount);
-        // Write Value
-        outputBuffer.push_type(m_value);
-    }
-    void read(const Buffer& inputBuffer, size_t& byteIndex) final {
-        // Read Attributes
-        // Type already read
-        inputBuffer.out_type(m_index, byteIndex);
-        byteIndex += sizeof(size_t);
-        inputBuffer.out_type(m_amount, byteIndex);
-        byteIndex += sizeof(size_t);
-        inputBuffer.out_type(m_value, byteIndex);
-        byteIndex += sizeof(char);
-    }
-
-    // Attributes
-    size_t m_amount = 0ULL;
-    std::byte m_value = static_cast<std::byte>(0);
+/** A diff instruction set, with the literal pool its records reference. */
+struct Instruction_Set {
+    std::vector<Instruction_Record> m_records;
+    std::vector<std::byte> m_literals;
 };
+/** Retrieve the largest byte-size a diff instruction record may encode to. */
+constexpr size_t record_size(const Instruction_Record& record) noexcept {
+    if (record.m_type == 'I' || record.m_type == 'A')
+        return sizeof(char) + (MaxVarintSize * 3ULL) + record.m_length;
+    return sizeof(char) + (MaxVarintSize * 3ULL) + record.m_period;
+}
+/** Write-out a diff instruction record to a buffer, relative to a cursor,
+followed by the data it carries, if any. */
+void write_record(
+    const Instruction_Record& record, const std::byte* const dataBytes,
+    Buffer& outputBuffer, Differential_Cursor& cursor) {
+    // Write Attributes
+    outputBuffer.push_type(record.m_type);
+    push_offset(outputBuffer, record.m_index, cursor.m_targetEnd);
+    push_varint(outputBuffer, record.m_length);
+    cursor.m_targetEnd = record.m_index + record.m_length;
+    if (record.m_type == 'C' || record.m_type == 'A') {
+        push_offset(outputBuffer, record.m_beginRead, cursor.m_sourceEnd);
+        cursor.m_sourceEnd = record.m_beginRead + record.m_length;
+    }
+
+    // Write Data
+    if (record.m_type == 'R')
+        outputBuffer.push_type(*dataBytes);
+    else if (record.m_type == 'P') {
+        push_varint(outputBuffer, record.m_period);
+        if (record.m_period != 0ULL)
+            outputBuffer.push_raw(dataBytes, record.m_period);
+    } else if (
+        (record.m_type == 'I' || record.m_type == 'A') &&
+        record.m_length != 0ULL)
+        outputBuffer.push_raw(dataBytes, record.m_length);
+}
+
+/** Retrieve the number of threads a diff may use. */
+size_t thread_count(const DiffOptions& options) noexcept {
+    return options.m_threadCount == 0ULL
+               ? static_cast<size_t>(std::thread::hardware_concurrency())
+               : options.m_threadCount;
+}
+
 /** Defines a matching region. */
 struct MatchInfo {
     size_t length = 0ULL, start1 = 0ULL, start2 = 0ULL;
@@ -164,319 +169,2369 @@ struct MatchInfo {
 struct WindowInfo {
     size_t windowSize = 0ULL, indexA = 0ULL, indexB = 0ULL;
 };
+/** The number of bits used to hash words within a diff window. */
+constexpr size_t WindowHashLog = 12ULL;
+/** The pattern lengths detected when looking for repeats in new data. */
+constexpr size_t RepeatPeriods[] = { 1ULL, 2ULL, 4ULL, 8ULL, 16ULL };
+/** The fewest bytes a longer repeating pattern must span to become a repeat,
+as compressing the diff already shrinks short ones about as well. */
+constexpr size_t PeriodicMinLength = 256ULL;
+/** The number of bytes in each source block indexed by rolling hash. */
+constexpr size_t RollingBlockSize = 32ULL;
+/** The shortest piece an in-place addition may be split into. */
+constexpr size_t MinInPlacePiece = 16ULL;
+/** The multiplier of the rolling hash, modulo 2^64. */
+constexpr size_t RollingHashBase = 0x100000001B3ULL;
+/** Compute the factor of the leading byte leaving a rolling hash block. */
+constexpr size_t rolling_leading_power() noexcept {
+    size_t power(1ULL);
+    for (size_t index = 1ULL; index < RollingBlockSize; ++index)
+        power *= RollingHashBase;
+    return power;
+}
+/** Index of fixed-size source blocks keyed by a Rabin-Karp rolling hash, so
+any target position can find a matching block anywhere in the source. */
+struct Rolling_Hash_Index {
+    // Public (de)Constructors
+    /** Construct an index over every aligned block of a source range, using
+    at most the number of buckets supplied, or 0 for no limit. */
+    Rolling_Hash_Index(const MemoryRange& source, const size_t& maxBuckets)
+        : m_source(source) {
+        // Use a power-of-two number of buckets, at least one per block
+        const auto blockCount = source.size() / RollingBlockSize;
+        size_t bucketBits(1ULL);
+        while ((1ULL << bucketBits) < blockCount &&
+               (maxBuckets == 0ULL || (2ULL << bucketBits) <= maxBuckets))
+            ++bucketBits;
+        m_shift = (sizeof(size_t) * 8ULL) - bucketBits;
+        m_buckets.resize(1ULL << bucketBits, 0ULL);
+
+        // Keep the first block per bucket, offset by one to mark it used
+        for (size_t index = 0ULL; index < blockCount; ++index) {
+            const auto offset = index * RollingBlockSize;
+            auto& bucket = m_buckets[bucket_of(hash(&source.bytes()[offset]))];
+            if (bucket == 0ULL)
+                bucket = offset + 1ULL;
+        }
+    }
+
+    // Public Methods
+    /** Hash a full block starting at the pointer supplied. */
+    [[nodiscard]] static size_t hash(const std::byte* const ptr) noexcept {
+        size_t value(0ULL);
+        for (size_t index = 0ULL; index < RollingBlockSize; ++index)
+            value = (value * Base) + static_cast<size_t>(ptr[index]);
+        return value;
+    }
+    /** Slide a block hash forward by one byte. */
+    [[nodiscard]] static size_t roll(
+        const size_t& value, const std::byte& outByte,
+        const std::byte& inByte) noexcept {
+        return ((value - (static_cast<size_t>(outByte) * LeadingPower)) *
+                Base) +
+               static_cast<size_t>(inByte);
+    }
+    /** Find the offset of a source block exactly matching the one supplied.
+    @return                 the source offset on success, empty otherwise. */
+    [[nodiscard]] std::optional<size_t>
+    find(const size_t& value, const std::byte* const ptr) const noexcept {
+        const auto bucket = m_buckets[bucket_of(value)];
+        if (bucket == 0ULL ||
+            std::memcmp(
+                &m_source.bytes()[bucket - 1ULL], ptr, RollingBlockSize) != 0)
+            return {}; // Failure
+        return bucket - 1ULL;
+    }
+
+    private:
+    // Private Methods
+    /** Map a block hash to a bucket, mixing its high bits. */
+    [[nodiscard]] size_t bucket_of(const size_t& value) const noexcept {
+        return (value * 0x9E3779B97F4A7C15ULL) >> m_shift;
+    }
+    // Private Attributes
+    static constexpr size_t Base = RollingHashBase;
+    static constexpr size_t LeadingPower = rolling_leading_power();
+    MemoryRange m_source;
+    std::vector<size_t> m_buckets;
+    size_t m_shift = 0ULL;
+};
 
 // Private Static Methods
 
-/** Find matching regions for 2 given ranges. */
-auto find_matching_regions(
-    const MemoryRange& rangeA, const MemoryRange& rangeB) {
-    std::vector<MatchInfo> bestMatch;
-    size_t largestMatch(0ULL);
-
-    // Algorithm Overview
-    // For each element in Range A, compare from element index -> end
-    // against entire Range B
-    std::for_each(
-        rangeA.cbegin_t<size_t>(), rangeA.cend_t<size_t>(),
-        [&](const size_t& elementA) {
-            size_t matchCount(0ULL);
-            size_t sumMatches(0ULL);
-            std::vector<MatchInfo> matches;
-            const size_t index_8byte =
-                &elementA - reinterpret_cast<const size_t*>(rangeA.cbegin());
-            const size_t index_byte = index_8byte * sizeof(size_t);
-            const auto subRangeA =
-                rangeA.subrange(index_byte, rangeA.size() - index_byte);
-            const auto length = std::min(subRangeA.size(), rangeB.size());
-
-            // Iterate through {subRangeA and rangeB} 8 bytes at a time
-            // Take note of matches >= 32 bytes in a row
-            for (size_t ind = 0ULL; ind < length; ind += 8ULL) {
-                const auto& byteA =
-                    *reinterpret_cast<const size_t*>(&subRangeA[ind]);
-                const auto& byteB =
-                    *reinterpret_cast<const size_t*>(&rangeB[ind]);
-                if (byteA == byteB)
-                    ++matchCount;
-                else {
-                    if (matchCount >= 4ULL) {
-                        const auto matchLength = matchCount * sizeof(size_t);
-                        matches.emplace_back(MatchInfo{
-                            matchLength, ind + index_byte - matchLength,
-                            ind - matchLength });
-                        sumMatches += matchCount;
-                    }
-                    matchCount = 0ULL;
+/** Read the compression header of a range, and the size it occupies. */
+std::optional<std::pair<CompressionHeader, size_t>>
+read_compression_header(const MemoryRange& memoryRange) {
+    // Ensure this range is large enough to hold any header
+    if (memoryRange.size() < sizeof(LegacyCompressionHeader))
+        return {}; // Failure
+
+    // Legacy headers are always LZ4 compressed
+    CompressionHeader header;
+    memoryRange.out_raw(header.m_title, sizeof(header.m_title));
+    if (std::strcmp(header.m_title, "yatta compress") == 0) {
+        LegacyCompressionHeader legacyHeader;
+        memoryRange.out_type(legacyHeader);
+        header.m_uncompressedSize = legacyHeader.m_uncompressedSize;
+        header.m_codecTag = Codec::LZ4;
+        if (header.m_uncompressedSize == 0ULL)
+            return {}; // Failure
+        return std::make_pair(header, sizeof(LegacyCompressionHeader));
+    }
+
+    // Ensure header title matches
+    if (std::strcmp(header.m_title, "yatta codec") != 0 ||
+        memoryRange.size() < sizeof(CompressionHeader))
+        return {}; // Failure
+    memoryRange.out_type(header);
+    if (header.m_uncompressedSize == 0ULL)
+        return {}; // Failure
+    return std::make_pair(header, sizeof(CompressionHeader));
+}
+
+/** Read the header of a seekable range, ensuring its block table fits. */
+std::optional<SeekableHeader>
+read_seekable_header(const MemoryRange& memoryRange) {
+    // Ensure this range is large enough to hold the header
+    if (memoryRange.size() < sizeof(SeekableHeader))
+        return {}; // Failure
+
+    // Ensure header title matches
+    SeekableHeader header;
+    memoryRange.out_type(header);
+    if (std::strcmp(header.m_title, "yatta seekable") != 0)
+        return {}; // Failure
+
+    // Ensure the block layout is consistent with the uncompressed size
+    if (header.m_uncompressedSize == 0ULL || header.m_blockSize == 0ULL ||
+        header.m_blockCount !=
+            ((header.m_uncompressedSize - 1ULL) / header.m_blockSize) + 1ULL)
+        return {}; // Failure
+
+    // Ensure the block table, holding an offset past every block, fits
+    const auto tableSize = memoryRange.size() - sizeof(SeekableHeader);
+    if (header.m_blockCount >= tableSize / sizeof(size_t))
+        return {}; // Failure
+    return header;
+}
+
+/** Retrieve a single compressed block from a seekable range. */
+std::optional<MemoryRange> read_seekable_block(
+    const MemoryRange& memoryRange, const SeekableHeader& header,
+    const size_t& blockIndex) {
+    // Read the block's bounds from the table
+    const auto tableIndex =
+        sizeof(SeekableHeader) + (sizeof(size_t) * blockIndex);
+    size_t blockBegin(0ULL);
+    size_t blockEnd(0ULL);
+    memoryRange.out_type(blockBegin, tableIndex);
+    memoryRange.out_type(blockEnd, tableIndex + sizeof(size_t));
+
+    // Ensure the block lies after the table, within the range
+    const auto tableSize = sizeof(size_t) * (header.m_blockCount + 1ULL);
+    const auto dataIndex = sizeof(SeekableHeader) + tableSize;
+    if (blockBegin > blockEnd || blockBegin < dataIndex ||
+        blockEnd > memoryRange.size())
+        return {}; // Failure
+    return memoryRange.subrange(blockBegin, blockEnd - blockBegin);
+}
+
+/** Reads the instructions of a diff in order, expanding one block at a time
+when they were compressed as a seekable range. */
+class Patch_Reader {
+    public:
+    // Public (de)Constructors
+    /** Construct a reader over a compressed range of instructions. Older and
+    smaller diffs are compressed whole, so they are expanded up front. */
+    explicit Patch_Reader(const MemoryRange& compressedRange)
+        : m_compressedRange(compressedRange),
+          m_header(read_seekable_header(compressedRange)) {
+        if (m_header.has_value())
+            m_block.reserve(m_header->m_blockSize);
+        else if (auto block = Buffer::decompress(compressedRange))
+            m_block = std::move(*block);
+        else
+            m_failed = true;
+    }
+    /** Construct a reader over instructions which were already expanded. */
+    explicit Patch_Reader(Buffer&& expandedBuffer) noexcept
+        : m_block(std::move(expandedBuffer)) {}
+
+    // Public Methods
+    /** Check if the instructions couldn't be expanded. */
+    [[nodiscard]] bool failed() const noexcept { return m_failed; }
+    /** Retrieve the instructions expanded so far, which are all of them
+    unless they were compressed as a seekable range. */
+    [[nodiscard]] const Buffer& expanded() const noexcept { return m_block; }
+    /** Retrieve the position of the next byte within the expanded
+    instructions. */
+    [[nodiscard]] size_t position() const noexcept { return m_byteIndex; }
+    /** Skip over raw bytes, which may span blocks.
+    @return                 true on success, false otherwise. */
+    [[nodiscard]] bool skip(const size_t& size) {
+        for (size_t skipped = 0ULL; skipped < size;) {
+            if (!fill())
+                return false; // Failure
+            const auto length =
+                std::min(size - skipped, m_block.size() - m_byteIndex);
+            skipped += length;
+            m_byteIndex += length;
+        }
+        return true; // Success
+    }
+    /** Read raw bytes, which may span blocks.
+    @return                 true on success, false otherwise. */
+    [[nodiscard]] bool read(void* const dataPtr, const size_t& size) {
+        auto* const bytes = static_cast<std::byte*>(dataPtr);
+        for (size_t copied = 0ULL; copied < size;) {
+            if (!fill())
+                return false; // Failure
+            const auto length =
+                std::min(size - copied, m_block.size() - m_byteIndex);
+            std::memcpy(&bytes[copied], &m_block.bytes()[m_byteIndex], length);
+            copied += length;
+            m_byteIndex += length;
+        }
+        return true; // Success
+    }
+    /** Read a fixed-width object.
+    @return                 true on success, false otherwise. */
+    template <typename T> [[nodiscard]] bool read_type(T& dataObj) {
+        if (m_block.size() - m_byteIndex < sizeof(T))
+            return read(&dataObj, sizeof(T));
+        std::memcpy(&dataObj, &m_block.bytes()[m_byteIndex], sizeof(T));
+        m_byteIndex += sizeof(T);
+        return true; // Success
+    }
+    /** Read a LEB128 varint.
+    @return                 true on success, false otherwise. */
+    [[nodiscard]] bool read_varint(size_t& value) {
+        // Decode straight from the block when the longest varint fits
+        value = 0ULL;
+        if (m_block.size() - m_byteIndex >= MaxVarintSize) {
+            const auto bytes = &m_block.bytes()[m_byteIndex];
+            for (size_t x = 0ULL; x < MaxVarintSize; ++x) {
+                const auto byte = static_cast<size_t>(bytes[x]);
+                value |= (byte & 0x7FULL) << (x * 7ULL);
+                if ((byte & 0x80ULL) == 0ULL) {
+                    m_byteIndex += x + 1ULL;
+                    return true; // Success
                 }
             }
+            m_byteIndex += MaxVarintSize;
+            return true; // Success
+        }
+        for (size_t shift = 0ULL; shift < sizeof(size_t) * CHAR_BIT;
+             shift += 7ULL) {
+            std::byte byte{};
+            if (!read_type(byte))
+                return false; // Failure
+            value |= (static_cast<size_t>(byte) & 0x7FULL) << shift;
+            if ((static_cast<size_t>(byte) & 0x80ULL) == 0ULL)
+                break;
+        }
+        return true; // Success
+    }
+    /** Read a signed distance from a base offset into a value.
+    @return                 true on success, false otherwise. */
+    [[nodiscard]] bool read_offset(size_t& value, const size_t& base) {
+        size_t encoded(0ULL);
+        if (!read_varint(encoded))
+            return false; // Failure
+        value = zigzag_decode(encoded, base);
+        return true; // Success
+    }
 
-            if (sumMatches > largestMatch) {
-                largestMatch = sumMatches;
-                bestMatch = matches;
+    private:
+    // Private Methods
+    /** Ensure unread bytes remain, expanding the next block if needed.
+    @return                 true if a byte may be read, false otherwise. */
+    bool fill() {
+        while (m_byteIndex == m_block.size()) {
+            if (!m_header.has_value() ||
+                m_blockIndex == m_header->m_blockCount)
+                return false; // Failure
+            const auto blockOffset = m_blockIndex * m_header->m_blockSize;
+            const auto blockLength = std::min(
+                m_header->m_blockSize,
+                m_header->m_uncompressedSize - blockOffset);
+            const auto block =
+                read_seekable_block(m_compressedRange, *m_header, m_blockIndex);
+            m_block.resize(blockLength);
+            if (!block.has_value() ||
+                Buffer::decompress(*block, m_block) != blockLength) {
+                m_failed = true;
+                return false; // Failure
             }
-        });
-    return bestMatch;
+            ++m_blockIndex;
+            m_byteIndex = 0ULL;
+        }
+        return true; // Success
+    }
+
+    // Private Attributes
+    MemoryRange m_compressedRange;
+    std::optional<SeekableHeader> m_header;
+    Buffer m_block;
+    size_t m_blockIndex = 0ULL;
+    size_t m_byteIndex = 0ULL;
+    bool m_failed = false;
+};
+
+/** Writes a patched target to a sink in order, staging small portions. */
+class Patch_Writer {
+    public:
+    // Public (de)Constructors
+    /** Construct a writer for a target of the size supplied. */
+    Patch_Writer(const size_t& targetSize, const Buffer::PatchSink& sink)
+        : m_targetSize(targetSize), m_sink(sink) {
+        m_stage.reserve(PatchStageSize);
+        m_stage.resize(PatchStageSize);
+    }
+
+    // Public Methods
+    /** Begin writing a portion of the target, zero-filling any gap before
+    it. Portions must be in order and within the target.
+    @return                 true on success, false otherwise. */
+    [[nodiscard]] bool
+    seek(const size_t& index, const size_t& length) {
+        if (index < m_written || index > m_targetSize ||
+            length > m_targetSize - index)
+            return false; // Failure
+        constexpr auto zero = std::byte{ 0 };
+        return fill(&zero, 1ULL, index - m_written);
+    }
+    /** Retrieve staged space for up to the number of bytes supplied, which
+    the caller must fill entirely.
+    @return                 the staged space on success, empty otherwise. */
+    [[nodiscard]] std::optional<MemoryRange> next(const size_t& maxLength) {
+        if (m_staged == PatchStageSize && !flush())
+            return {}; // Failure
+        const auto length = std::min(maxLength, PatchStageSize - m_staged);
+        const auto portion = m_stage.subrange(m_staged, length);
+        m_staged += length;
+        m_written += length;
+        return portion;
+    }
+    /** Write a portion of memory, passing large portions straight through.
+    @return                 true on success, false otherwise. */
+    [[nodiscard]] bool write(const MemoryRange& memoryRange) {
+        if (memoryRange.size() >= PatchStageSize) {
+            m_written += memoryRange.size();
+            return flush() && m_sink(memoryRange);
+        }
+        for (size_t offset = 0ULL; offset < memoryRange.size();) {
+            const auto portion = next(memoryRange.size() - offset);
+            if (!portion.has_value())
+                return false; // Failure
+            std::memcpy(
+                portion->bytes(), &memoryRange.bytes()[offset],
+                portion->size());
+            offset += portion->size();
+        }
+        return true; // Success
+    }
+    /** Write a pattern repeatedly, until the length supplied is reached.
+    @return                 true on success, false otherwise. */
+    [[nodiscard]] bool fill(
+        const std::byte* const pattern, const size_t& period,
+        const size_t& length) {
+        for (size_t offset = 0ULL; offset < length;) {
+            const auto portion = next(length - offset);
+            if (!portion.has_value())
+                return false; // Failure
+
+            // Write the pattern once from its current phase, then double it
+            const auto bytes = portion->bytes();
+            const auto size = portion->size();
+            const auto lead = std::min(period, size);
+            for (size_t x = 0ULL; x < lead; ++x)
+                bytes[x] = pattern[(offset + x) % period];
+            for (size_t filled = lead; filled < size; filled *= 2ULL)
+                std::memcpy(
+                    &bytes[filled], bytes, std::min(filled, size - filled));
+            offset += size;
+        }
+        return true; // Success
+    }
+    /** Zero-fill the rest of the target, then flush it to the sink.
+    @return                 true on success, false otherwise. */
+    [[nodiscard]] bool finish() { return seek(m_targetSize, 0ULL) && flush(); }
+
+    private:
+    // Private Methods
+    /** Pass the staged portion to the sink. */
+    bool flush() {
+        if (m_staged == 0ULL)
+            return true; // Success
+        const auto staged = m_stage.subrange(0ULL, m_staged);
+        m_staged = 0ULL;
+        return m_sink(staged);
+    }
+
+    // Private Attributes
+    size_t m_targetSize = 0ULL;
+    Buffer::PatchSink m_sink;
+    Buffer m_stage;
+    size_t m_staged = 0ULL;
+    size_t m_written = 0ULL;
+};
+
+/** Read where a diff instruction begins in the target, its length, and where
+it reads from in the source, leaving any data to be read after.
+@return                 true on success, false otherwise. */
+bool read_instruction_fields(
+    const char& type, const bool& legacy, Patch_Reader& reader,
+    Differential_Cursor& cursor, size_t& index, size_t& length,
+    size_t& beginRead) {
+    const auto readsSource = type == 'C' || type == 'A';
+    if (legacy) {
+        // Older copies store where they end, older additions lead with it
+        size_t endRead(0ULL);
+        if (!reader.read_type(index) ||
+            (readsSource && !reader.read_type(beginRead)) ||
+            !reader.read_type(type == 'C' ? endRead : length))
+            return false; // Failure
+        if (type == 'C') {
+            if (endRead < beginRead)
+                return false; // Failure
+            length = endRead - beginRead;
+        }
+    } else {
+        if (!reader.read_offset(index, cursor.m_targetEnd) ||
+            !reader.read_varint(length) ||
+            (readsSource &&
+             !reader.read_offset(beginRead, cursor.m_sourceEnd)))
+            return false; // Failure
+        cursor.m_targetEnd = index + length;
+        if (readsSource)
+            cursor.m_sourceEnd = beginRead + length;
+    }
+    return true; // Success
+}
+
+/** An instruction of an expanded patch, decoded and validated ahead of
+executing it. */
+struct Patch_Record {
+    /** The type of the instruction. */
+    char m_type = 'I';
+    /** The target range the instruction writes to. */
+    size_t m_index = 0ULL, m_length = 0ULL;
+    /** The source offset read by copies and additions. */
+    size_t m_beginRead = 0ULL;
+    /** Where the instruction's data begins within the expanded patch. */
+    size_t m_data = 0ULL;
+    /** The pattern length of periodic instructions, at most their length. */
+    size_t m_period = 0ULL;
+    /** The base read by copies and additions. */
+    size_t m_base = 0ULL;
+};
+/** Every instruction within an expanded patch. */
+struct Patch_Index {
+    /** The instructions writing any bytes, in the order written. */
+    std::vector<Patch_Record> m_records;
+    /** Whether the instructions write the target in order, and so never
+    overlap. */
+    bool m_ordered = true;
+};
+
+/** Decode every instruction of an expanded patch, ensuring each only writes
+within the target, and only reads within the patch and its bases, then visit
+those writing any bytes in order.
+@return                 true on success, false otherwise. */
+template <typename Visitor>
+bool decode_instructions(
+    Patch_Reader& reader, const bool& legacy, const size_t& targetSize,
+    const std::vector<MemoryRange>& baseMemories, Visitor&& visitor) {
+    Differential_Cursor cursor;
+    std::vector<size_t> baseEnds(baseMemories.size());
+    size_t base(0ULL);
+    char type(0);
+    while (reader.read_type(type)) {
+        // Older diffs were written after a zeroed prefix, which is skipped
+        if (legacy && type == '\0')
+            continue;
+
+        // Switch which base is read from, resuming where it was last read
+        if (type == 'B') {
+            size_t nextBase(0ULL);
+            if (legacy || !reader.read_varint(nextBase) ||
+                nextBase >= baseMemories.size())
+                return false; // Failure
+            baseEnds[base] = cursor.m_sourceEnd;
+            base = nextBase;
+            cursor.m_sourceEnd = baseEnds[base];
+            continue;
+        }
+
+        // Read where the instruction begins, its length, and its source
+        Patch_Record record{ type };
+        record.m_base = base;
+        auto& index = record.m_index;
+        auto& length = record.m_length;
+        auto& beginRead = record.m_beginRead;
+        if (!read_instruction_fields(
+                type, legacy, reader, cursor, index, length, beginRead))
+            return false; // Failure
+
+        // Ensure it lies within the target, and the source if it reads it
+        const auto readsSource = type == 'C' || type == 'A';
+        const auto sourceSize = baseMemories[base].size();
+        if (index > targetSize || length > targetSize - index ||
+            (readsSource &&
+             (beginRead > sourceSize || length > sourceSize - beginRead)))
+            return false; // Failure
+
+        // Ensure its data lies within the patch, skipping over it
+        size_t dataSize(0ULL);
+        if (type == 'R')
+            dataSize = sizeof(std::byte);
+        else if (type == 'I' || type == 'A')
+            dataSize = length;
+        else if (
+            type == 'P' && !(legacy ? reader.read_type(dataSize)
+                                    : reader.read_varint(dataSize)))
+            return false; // Failure
+        else if (type != 'C' && type != 'P')
+            return false; // Failure
+
+        // Ensure periodic instructions repeat no more than they write
+        if (type == 'P' && dataSize > length)
+            return false; // Failure
+        record.m_data = reader.position();
+        if (type == 'P')
+            record.m_period = dataSize;
+        if (!reader.skip(dataSize))
+            return false; // Failure
+
+        // Instructions writing nothing have nothing to execute
+        if (length != 0ULL)
+            visitor(record);
+    }
+    return !reader.failed();
+}
+
+/** Index every instruction of an expanded patch, ensuring each only writes
+within the target, and only reads within the patch and its bases.
+@return                 the index on success, empty otherwise. */
+std::optional<Patch_Index> index_instructions(
+    Patch_Reader& reader, const bool& legacy, const size_t& targetSize,
+    const std::vector<MemoryRange>& baseMemories) {
+    Patch_Index patchIndex;
+    size_t targetEnd(0ULL);
+    const auto indexRecord = [&](const Patch_Record& record) {
+        patchIndex.m_ordered =
+            patchIndex.m_ordered && record.m_index >= targetEnd;
+        targetEnd = record.m_index + record.m_length;
+        patchIndex.m_records.emplace_back(record);
+    };
+    if (!decode_instructions(
+            reader, legacy, targetSize, baseMemories, indexRecord))
+        return {}; // Failure
+    return patchIndex;
+}
+
+/** Execute an indexed instruction of an expanded patch. Its bounds were
+validated while indexing, so it's applied without checking them again. */
+void execute_instruction(
+    const Patch_Record& record, const std::byte* const patchBytes,
+    std::byte* const targetBytes,
+    const std::vector<MemoryRange>& baseMemories) noexcept {
+    const auto sourceBytes = baseMemories[record.m_base].bytes();
+    const auto bytes = &targetBytes[record.m_index];
+    const auto data = &patchBytes[record.m_data];
+    const auto& length = record.m_length;
+    if (record.m_type == 'C')
+        std::memcpy(bytes, &sourceBytes[record.m_beginRead], length);
+    else if (record.m_type == 'I')
+        std::memcpy(bytes, data, length);
+    else if (record.m_type == 'R')
+        std::memset(bytes, static_cast<int>(*data), length);
+    else if (record.m_type == 'A')
+        add_differences(bytes, &sourceBytes[record.m_beginRead], data, length);
+    else if (record.m_type == 'P' && record.m_period != 0ULL) {
+        // Write the pattern once, then keep doubling it
+        std::memcpy(bytes, data, record.m_period);
+        for (auto filled = record.m_period; filled < length; filled *= 2ULL)
+            std::memcpy(
+                &bytes[filled], bytes, std::min(filled, length - filled));
+    }
+}
+
+/** Patch a target from the bases a diff's instructions read from, executing
+them in parallel when the target is large enough to split.
+@return                 the patched buffer on success, empty otherwise. */
+std::optional<Buffer> apply_patch(
+    const std::vector<MemoryRange>& baseMemories,
+    const MemoryRange& instructionMemory, const size_t& targetSize,
+    const bool& legacy) {
+    // Try to decompress the instructions
+    auto patchBuffer = Buffer::decompress(instructionMemory);
+    if (!patchBuffer.has_value())
+        return {}; // Failure
+
+    // Allocate only the target's size
+    Buffer bufferNew;
+    bufferNew.reserve(targetSize);
+    bufferNew.resize(targetSize);
+    Patch_Reader reader(std::move(*patchBuffer));
+    const auto patchBytes = reader.expanded().bytes();
+    const auto executeRecord = [&](const Patch_Record& record) {
+        execute_instruction(
+            record, patchBytes, bufferNew.bytes(), baseMemories);
+    };
+
+    // Targets too small to split, or with only a single core to split them
+    // across, execute each instruction as soon as it's validated
+    if (targetSize < PatchJobSize * 2ULL ||
+        std::thread::hardware_concurrency() < 2U) {
+        if (!decode_instructions(
+                reader, legacy, targetSize, baseMemories,
+                executeRecord))
+            return {}; // Failure
+        return bufferNew; // Success
+    }
+
+    // Index every instruction, so they may be executed in any order
+    const auto patchIndex = index_instructions(
+        reader, legacy, targetSize, baseMemories);
+    if (!patchIndex.has_value())
+        return {}; // Failure
+    const auto& records = patchIndex->m_records;
+
+    // Group instructions into jobs writing similar amounts of the target
+    std::vector<size_t> jobBegins{ 0ULL };
+    for (size_t x = 0ULL, jobLength = 0ULL; x < records.size(); ++x) {
+        jobLength += records[x].m_length;
+        if (jobLength >= PatchJobSize) {
+            jobBegins.push_back(x + 1ULL);
+            jobLength = 0ULL;
+        }
+    }
+    if (jobBegins.back() != records.size())
+        jobBegins.push_back(records.size());
+    const auto jobCount = jobBegins.size() - 1ULL;
+    const auto executeJob = [&](const size_t& job) {
+        for (auto x = jobBegins[job]; x < jobBegins[job + 1ULL]; ++x)
+            executeRecord(records[x]);
+    };
+
+    // Instructions in target order write disjoint ranges, so run in parallel
+    if (!patchIndex->m_ordered || jobCount < 2ULL) {
+        for (size_t job = 0ULL; job < jobCount; ++job)
+            executeJob(job);
+        return bufferNew; // Success
+    }
+    Threader threader;
+    for (size_t job = 0ULL; job < jobCount; ++job)
+        threader.addJob([&, job]() { executeJob(job); });
+
+    // Wait for jobs to finish
+    while (!threader.isFinished())
+        continue;
+    threader.shutdown();
+
+    // Success
+    return bufferNew;
+}
+
+/** Read and stream a single diff instruction to a patch writer.
+@return                 true on success, false otherwise. */
+bool stream_instruction(
+    const char& type, Patch_Reader& reader, Patch_Writer& writer,
+    Differential_Cursor& cursor, const MemoryRange& sourceMemory) {
+    // Read where the instruction begins, its length, and where it reads from
+    size_t index(0ULL);
+    size_t length(0ULL);
+    size_t beginRead(0ULL);
+    const auto readsSource = type == 'C' || type == 'A';
+    if (!read_instruction_fields(
+            type, false, reader, cursor, index, length, beginRead))
+        return false; // Failure
+
+    // Ensure the instruction follows the last, and lies within both ranges
+    if (!writer.seek(index, length) ||
+        (readsSource && (beginRead > sourceMemory.size() ||
+                         length > sourceMemory.size() - beginRead)))
+        return false; // Failure
+
+    // Stream the instruction's data to the writer
+    if (type == 'C')
+        return writer.write(sourceMemory.subrange(beginRead, length));
+    if (type == 'R') {
+        std::byte value{};
+        return reader.read_type(value) && writer.fill(&value, 1ULL, length);
+    }
+    if (type == 'P') {
+        // Empty patterns leave their range zeroed
+        size_t period(0ULL);
+        if (!reader.read_varint(period) || period > length)
+            return false; // Failure
+        std::vector<std::byte> pattern(std::max<size_t>(period, 1ULL));
+        return reader.read(pattern.data(), period) &&
+               writer.fill(pattern.data(), pattern.size(), length);
+    }
+    if (type != 'I' && type != 'A')
+        return false; // Failure
+    for (size_t offset = 0ULL; offset < length;) {
+        auto portion = writer.next(length - offset);
+        if (!portion.has_value() ||
+            !reader.read(portion->bytes(), portion->size()))
+            return false; // Failure
+
+        // Additions apply their differences onto the source
+        if (type == 'A')
+            add_differences(
+                portion->bytes(), &sourceMemory.bytes()[beginRead + offset],
+                portion->bytes(), portion->size());
+        offset += portion->size();
+    }
+    return true; // Success
+}
+
+/** Read and apply a single in-place diff instruction, overwriting the source
+held at the front of a buffer. Copies may overlap what they write, while
+additions never write ahead of what they read.
+@return                 true on success, false otherwise. */
+bool apply_in_place(
+    const char& type, Patch_Reader& reader, Buffer& buffer,
+    Differential_Cursor& cursor, const size_t& sourceSize) {
+    // Read where the instruction begins, its length, and where it reads from
+    size_t index(0ULL);
+    size_t length(0ULL);
+    size_t beginRead(0ULL);
+    const auto readsSource = type == 'C' || type == 'A';
+    if (!read_instruction_fields(
+            type, false, reader, cursor, index, length, beginRead))
+        return false; // Failure
+
+    // Ensure the instruction lies within the buffer, and the source
+    if (index > buffer.size() || length > buffer.size() - index ||
+        (readsSource &&
+         (beginRead > sourceSize || length > sourceSize - beginRead)))
+        return false; // Failure
+    const auto bytes = &buffer.bytes()[index];
+    if (type == 'C') {
+        std::memmove(bytes, &buffer.bytes()[beginRead], length);
+        return true; // Success
+    }
+    if (type == 'I')
+        return reader.read(bytes, length);
+    if (type == 'R') {
+        std::byte value{};
+        if (!reader.read_type(value))
+            return false; // Failure
+        std::fill(bytes, &bytes[length], value);
+        return true; // Success
+    }
+    if (type == 'P') {
+        // Write the pattern once, then keep doubling it
+        size_t period(0ULL);
+        if (!reader.read_varint(period) || period > length)
+            return false; // Failure
+        if (period == 0ULL) {
+            std::fill(bytes, &bytes[length], std::byte{ 0 });
+            return true; // Success
+        }
+        if (!reader.read(bytes, period))
+            return false; // Failure
+        for (size_t filled = period; filled < length; filled *= 2ULL)
+            std::memcpy(
+                &bytes[filled], bytes, std::min(filled, length - filled));
+        return true; // Success
+    }
+    if (type != 'A')
+        return false; // Failure
+
+    // Stage differences a portion at a time, reading before overwriting
+    thread_local std::vector<std::byte> portion(PatchStageSize);
+    for (size_t offset = 0ULL; offset < length;) {
+        const auto portionSize = std::min(PatchStageSize, length - offset);
+        if (!reader.read(portion.data(), portionSize))
+            return false; // Failure
+        add_differences(
+            portion.data(), &buffer.bytes()[beginRead + offset],
+            portion.data(), portionSize);
+        std::memmove(&bytes[offset], portion.data(), portionSize);
+        offset += portionSize;
+    }
+    return true; // Success
+}
+
+/** Read an unaligned word from the pointer supplied. */
+size_t load_word(const std::byte* const ptr) noexcept {
+    size_t word(0ULL);
+    std::memcpy(&word, ptr, sizeof(size_t));
+    return word;
 }
 
-/** Split 2 ranges and find their matching ranges. */
+/** Hash a word into the number of bits supplied. */
+size_t
+hash_window_word(const size_t& word, const size_t& hashLog) noexcept {
+    return (word * 0x9E3779B97F4A7C15ULL) >>
+           ((sizeof(size_t) * 8ULL) - hashLog);
+}
+
+/** Find matching regions for 2 given ranges, given positions of range A
+chained by the hash of the word found there. Each position of range B greedily
+takes the longest match among the chained positions from its bucket's head
+back to the first position allowed, extended byte by byte in both directions.
+*/
+std::vector<MatchInfo> match_chained_regions(
+    const MemoryRange& rangeA, const MemoryRange& rangeB,
+    const size_t* const heads, const size_t* const chain,
+    const size_t& hashLog, const size_t& beginA, size_t diagonalA,
+    const DiffOptions& options) {
+    std::vector<MatchInfo> matches;
+    constexpr auto wordSize = sizeof(size_t);
+    const auto minLength = std::max(options.m_minMatch, wordSize);
+    const auto sizeA = rangeA.size();
+    const auto sizeB = rangeB.size();
+    if (sizeA < minLength || sizeB < minLength)
+        return matches;
+    const auto bytesA = rangeA.bytes();
+    const auto bytesB = rangeB.bytes();
+
+    // Take the longest match at each position of range B, skipping past it
+    size_t lastMatchEnd(0ULL);
+    for (size_t indexB = 0ULL; indexB + wordSize <= sizeB;) {
+        const auto remaining = sizeB - indexB;
+        size_t bestLength(0ULL);
+        size_t bestStart(0ULL);
+        const auto try_candidate = [&](const size_t& indexA) noexcept {
+            const auto length = Kernels::commonPrefix(
+                &bytesA[indexA], &bytesB[indexB],
+                std::min<size_t>(sizeA - indexA, remaining));
+            if (length > bestLength) {
+                bestLength = length;
+                bestStart = indexA;
+            }
+        };
+
+        // Try continuing along the previous match's diagonal first, as
+        // chains favour later candidates truncated by the end of range A
+        if (diagonalA < sizeA)
+            try_candidate(diagonalA);
+        auto candidate =
+            heads[hash_window_word(load_word(&bytesB[indexB]), hashLog)];
+        for (size_t attempt = 0ULL; candidate > beginA &&
+                                    attempt < options.m_searchDepth &&
+                                    bestLength < remaining;
+             ++attempt, candidate = chain[candidate - 1ULL])
+            try_candidate(candidate - 1ULL);
+
+        // Extend the best match backwards, up to the previous match
+        const auto before =
+            bestLength == 0ULL
+                ? 0ULL
+                : Kernels::commonSuffix(
+                      &bytesA[bestStart], &bytesB[indexB],
+                      std::min(bestStart, indexB - lastMatchEnd));
+
+        // Keep matches spanning at least the minimum length
+        if (bestLength + before >= minLength) {
+            matches.emplace_back(MatchInfo{
+                before + bestLength, bestStart - before, indexB - before });
+            indexB += bestLength;
+            lastMatchEnd = indexB;
+            diagonalA = bestStart + bestLength;
+        } else {
+            ++indexB;
+            ++diagonalA;
+        }
+    }
+    return matches;
+}
+
+/** Find matching regions for 2 given ranges, chaining every byte offset of
+range A by the hash of the word found there. */
+std::vector<MatchInfo> find_matching_regions(
+    const MemoryRange& rangeA, const MemoryRange& rangeB,
+    const DiffOptions& options) {
+    // Chain every position of range A, offset by one to mark it used
+    constexpr auto wordSize = sizeof(size_t);
+    const auto sizeA = rangeA.size();
+    const auto bytesA = rangeA.bytes();
+    thread_local std::vector<size_t> heads;
+    thread_local std::vector<size_t> chain;
+    heads.assign(1ULL << WindowHashLog, 0ULL);
+    chain.resize(sizeA);
+    for (size_t indexA = 0ULL; indexA + wordSize <= sizeA; ++indexA) {
+        auto& head =
+            heads[hash_window_word(load_word(&bytesA[indexA]), WindowHashLog)];
+        chain[indexA] = head;
+        head = indexA + 1ULL;
+    }
+    return match_chained_regions(
+        rangeA, rangeB, heads.data(), chain.data(), WindowHashLog, 0ULL, 0ULL,
+        options);
+}
+
+/** Every position of a source chained by the hash of the word found there,
+once for all diffs from it. The head of each bucket is kept as it stood at
+the end of every window too, so each target window can walk the positions
+before the end of its neighbouring windows without chaining them again. */
+struct Window_Chains {
+    // Public (de)Constructors
+    /** Chain every position of a source range, for the window size supplied.
+    Buckets shrink with smaller windows, keeping the heads kept per window
+    smaller than the window itself. */
+    Window_Chains(const MemoryRange& source, const size_t& windowSize)
+        : m_windowSize(std::max<size_t>(windowSize, 1ULL)),
+          m_hashLog(chain_hash_log(m_windowSize)) {
+        constexpr auto wordSize = sizeof(size_t);
+        const auto size = source.size();
+        const auto windowCount = (size + m_windowSize - 1ULL) / m_windowSize;
+        std::vector<size_t> heads(1ULL << m_hashLog, 0ULL);
+        m_chain.resize(size);
+        m_heads.reserve(windowCount << m_hashLog);
+        for (size_t window = 0ULL; window < windowCount; ++window) {
+            const auto windowEnd =
+                std::min<size_t>(size, (window + 1ULL) * m_windowSize);
+            for (size_t index = window * m_windowSize;
+                 index < windowEnd && index + wordSize <= size; ++index) {
+                auto& head = heads[hash_window_word(
+                    load_word(&source.bytes()[index]), m_hashLog)];
+                m_chain[index] = head;
+                head = index + 1ULL;
+            }
+            m_heads.insert(m_heads.end(), heads.cbegin(), heads.cend());
+        }
+    }
+
+    // Public Methods
+    /** Find matching regions for a target window aligned to the source
+    offset supplied, searching its neighbouring source windows too. */
+    [[nodiscard]] std::vector<MatchInfo> match(
+        const MemoryRange& source, const MemoryRange& targetWindow,
+        const size_t& alignedIndex, const DiffOptions& options) const {
+        const auto windowCount = m_heads.size() >> m_hashLog;
+        const auto beginA = alignedIndex - std::min(alignedIndex, m_windowSize);
+        const auto lastWindow = std::min<size_t>(
+            (alignedIndex + (m_windowSize * 3ULL) - 1ULL) / m_windowSize,
+            windowCount);
+        if (lastWindow == 0ULL || beginA >= source.size())
+            return {};
+        return match_chained_regions(
+            source, targetWindow, &m_heads[(lastWindow - 1ULL) << m_hashLog],
+            m_chain.data(), m_hashLog, beginA, alignedIndex, options);
+    }
+    /** Retrieve the byte size of the windows chained.
+    @return                 the window size. */
+    [[nodiscard]] size_t windowSize() const noexcept { return m_windowSize; }
+    /** Retrieve the number of bytes chains take for a source range.
+    @return                 the byte size of its chains. */
+    [[nodiscard]] static size_t byte_size(
+        const MemoryRange& source, const size_t& windowSize) noexcept {
+        const auto window = std::max<size_t>(windowSize, 1ULL);
+        const auto windowCount = (source.size() + window - 1ULL) / window;
+        return (source.size() + (windowCount << chain_hash_log(window))) *
+               sizeof(size_t);
+    }
+
+    private:
+    // Private Methods
+    /** Find the number of bits to hash words with for a window size. */
+    [[nodiscard]] static size_t
+    chain_hash_log(const size_t& windowSize) noexcept {
+        size_t hashLog(WindowHashLog);
+        while (hashLog > 1ULL && (4ULL << hashLog) > windowSize)
+            --hashLog;
+        return hashLog;
+    }
+    // Private Attributes
+    size_t m_windowSize = 0ULL;
+    size_t m_hashLog = 0ULL;
+    std::vector<size_t> m_heads;
+    std::vector<size_t> m_chain;
+};
+
+/** Split 2 ranges and find their matching ranges, in window order. */
 auto split_and_match_ranges(
     const MemoryRange& rangeA, const MemoryRange& rangeB, size_t& indexA,
-    size_t& indexB) {
+    size_t& indexB, const DiffOptions& options) {
     const auto sizeA = rangeA.size();
     const auto sizeB = rangeB.size();
-    std::mutex matchMutex;
     std::vector<std::pair<WindowInfo, std::vector<MatchInfo>>> matchingRegions;
-
-    Threader threader;
     while (indexA < sizeA && indexB < sizeB) {
         const auto windowSize = std::min(
-            static_cast<size_t>(4096ULL),
+            std::max<size_t>(options.m_windowSize, 1ULL),
             std::min(sizeA - indexA, sizeB - indexB));
+        matchingRegions.emplace_back(
+            WindowInfo{ windowSize, indexA, indexB }, std::vector<MatchInfo>());
 
-        threader.addJob([&, windowSize, indexA, indexB]() {
-            const auto windowA = rangeA.subrange(indexA, windowSize);
-            const auto windowB = rangeB.subrange(indexB, windowSize);
-            auto matches = find_matching_regions(windowA, windowB);
+        // increment
+        indexA += windowSize;
+        indexB += windowSize;
+    }
+
+    // Match every window in a separate thread, each filling its own slot
+    Threader threader(thread_count(options));
+    for (size_t x = 0ULL; x < matchingRegions.size(); ++x) {
+        threader.addJob([&, x]() {
+            // Search the neighbouring windows of A too, tolerating shifts
+            auto& [windowInfo, matches] = matchingRegions[x];
+            const auto& [windowSize, windowA, windowB] = windowInfo;
+            const auto beginA = windowA - std::min(windowA, windowSize);
+            const auto endA =
+                std::min<size_t>(sizeA, windowA + (windowSize * 2ULL));
+            matches = find_matching_regions(
+                rangeA.subrange(beginA, endA - beginA),
+                rangeB.subrange(windowB, windowSize), options);
             for (auto& matchInfo : matches) {
-                matchInfo.start1 += indexA;
-                matchInfo.start2 += indexB;
+                matchInfo.start1 += beginA;
+                matchInfo.start2 += windowB;
             }
+        });
+    }
 
-            std::unique_lock<std::mutex> writeGuard(matchMutex);
-            matchingRegions.emplace_back(
-                WindowInfo{ windowSize, indexA, indexB }, matches);
+    // Wait for jobs to finish
+    while (!threader.isFinished())
+        continue;
+
+    return matchingRegions;
+}
+
+/** Split a target range into windows aligned to a chained source, offset
+by the index supplied, and find their matching ranges, in window order. */
+auto match_indexed_windows(
+    const Window_Chains& chains, const MemoryRange& sourceMemory,
+    const MemoryRange& targetRange, const size_t& offset,
+    const DiffOptions& options) {
+    const auto size = targetRange.size();
+    std::vector<std::pair<WindowInfo, std::vector<MatchInfo>>> matchingRegions;
+    for (size_t index = 0ULL; index < size; index += chains.windowSize())
+        matchingRegions.emplace_back(
+            WindowInfo{ std::min(chains.windowSize(), size - index),
+                        offset + index, index },
+            std::vector<MatchInfo>());
+
+    // Match every window in a separate thread, each filling its own slot
+    Threader threader(thread_count(options));
+    for (size_t x = 0ULL; x < matchingRegions.size(); ++x) {
+        threader.addJob([&, x]() {
+            auto& [windowInfo, matches] = matchingRegions[x];
+            const auto& [windowSize, windowA, windowB] = windowInfo;
+            matches = chains.match(
+                sourceMemory, targetRange.subrange(windowB, windowSize),
+                windowA, options);
+            for (auto& matchInfo : matches)
+                matchInfo.start2 += windowB;
         });
+    }
 
-        // increment
-        indexA += windowSize;
-        indexB += windowSize;
+    // Wait for jobs to finish
+    while (!threader.isFinished())
+        continue;
+
+    return matchingRegions;
+}
+
+/** Generate and emplace a new insertion instruction. */
+void emplace_insertion(
+    const size_t& index, const size_t& length,
+    std::vector<Instruction_Record>& records) {
+    records.emplace_back(
+        Instruction_Record{ 'I', 0ULL, index, length, 0ULL, 0ULL });
+}
+
+/** Generate and emplace a new copy instruction. */
+void emplace_copy(
+    const size_t& index, const size_t& beginRead, const size_t& endRead,
+    std::vector<Instruction_Record>& records) {
+    records.emplace_back(Instruction_Record{
+        'C', 0ULL, index, endRead - beginRead, beginRead, 0ULL });
+}
+
+/** Generate and emplace instructions for new data. Values or short patterns
+repeating long enough become repeats as soon as they end, and everything
+else becomes insertions. */
+void emplace_new_data(
+    const size_t& index, const MemoryRange& newData, const size_t& minRepeat,
+    std::vector<Instruction_Record>& records) {
+    constexpr auto periodCount = std::size(RepeatPeriods);
+    const auto bytes = newData.bytes();
+    const auto size = newData.size();
+    size_t streaks[periodCount] = {};
+    bool repeating[periodCount] = {};
+    size_t lastRunEnd(0ULL);
+    for (size_t x = 0ULL; x <= size; ++x) {
+        // Track how many bytes in a row match the byte one period earlier
+        for (size_t p = 0ULL; p < periodCount; ++p) {
+            const auto& period = RepeatPeriods[p];
+            repeating[p] =
+                x < size && x >= period && bytes[x] == bytes[x - period];
+            if (repeating[p])
+                ++streaks[p];
+        }
+
+        // Emit runs which just ended, unless a run still going covers them
+        for (size_t p = 0ULL; p < periodCount; ++p) {
+            if (repeating[p] || streaks[p] == 0ULL)
+                continue;
+            const auto& period = RepeatPeriods[p];
+            const auto runBegin =
+                std::max(x - streaks[p] - period, lastRunEnd);
+            streaks[p] = 0ULL;
+            if (x < runBegin + (period == 1ULL ? minRepeat
+                                               : std::max(minRepeat,
+                                                          PeriodicMinLength)))
+                continue;
+            bool covered(false);
+            for (size_t q = 0ULL; q < periodCount; ++q)
+                covered |= repeating[q] &&
+                           x + 1ULL <= runBegin + streaks[q] + RepeatPeriods[q];
+            if (covered)
+                continue;
+
+            // INSERT data from end of the last run until now, then REPEAT
+            if (runBegin > lastRunEnd)
+                emplace_insertion(
+                    index + lastRunEnd, runBegin - lastRunEnd, records);
+            records.emplace_back(Instruction_Record{
+                period == 1ULL ? 'R' : 'P', period, index + runBegin,
+                x - runBegin, 0ULL, 0ULL });
+            lastRunEnd = x;
+        }
+
+        // Skip ahead while a single value keeps repeating, as every period
+        // keeps matching and nothing can end until the value changes
+        if (std::all_of(
+                std::begin(repeating), std::end(repeating),
+                [](const bool& value) noexcept { return value; })) {
+            auto skip = Kernels::runLength(
+                &bytes[x + 1ULL], bytes[x], size - x - 1ULL);
+            for (size_t p = 1ULL; p < periodCount && skip > 0ULL; ++p)
+                skip = Kernels::commonPrefix(
+                    &bytes[x + 1ULL], &bytes[x + 1ULL - RepeatPeriods[p]],
+                    skip);
+            for (auto& streak : streaks)
+                streak += skip;
+            x += skip;
+        }
+    }
+
+    // INSERT data from end of the last run until the end
+    if (size > lastRunEnd)
+        emplace_insertion(index + lastRunEnd, size - lastRunEnd, records);
+}
+
+/** Generate a diff instruction set from the matching regions of a range's
+windows, up to the index supplied, inserting everything after it. Instructions
+are sorted by target index. */
+Instruction_Set windows_to_instructions(
+    const std::vector<std::pair<WindowInfo, std::vector<MatchInfo>>>&
+        matchingRegions,
+    const MemoryRange& rangeB, const size_t& indexB,
+    const DiffOptions& options) {
+    // Convert every window in a separate thread, each into its own records
+    std::vector<std::vector<Instruction_Record>> windowRecords(
+        matchingRegions.size());
+    Threader threader(thread_count(options));
+    for (size_t x = 0ULL; x < matchingRegions.size(); ++x) {
+        threader.addJob([&, x]() {
+            const auto& [windowInfo, matches] = matchingRegions[x];
+            auto& records = windowRecords[x];
+            size_t lastMatchEnd(windowInfo.indexB);
+            for (auto& matchInfo : matches) {
+                // INSERT data from end of the last match until now
+                const auto newDataLength = matchInfo.start2 - lastMatchEnd;
+                if (newDataLength > 0ULL)
+                    emplace_new_data(
+                        lastMatchEnd,
+                        rangeB.subrange(lastMatchEnd, newDataLength),
+                        options.m_minRepeat, records);
+
+                // COPY data in matching region
+                emplace_copy(
+                    matchInfo.start2, matchInfo.start1,
+                    matchInfo.start1 + matchInfo.length, records);
+                lastMatchEnd = matchInfo.start2 + matchInfo.length;
+            }
+
+            // INSERT data from end of the last match until window end
+            const auto newDataLength =
+                (windowInfo.indexB + windowInfo.windowSize) - lastMatchEnd;
+            if (newDataLength > 0ULL)
+                emplace_new_data(
+                    lastMatchEnd, rangeB.subrange(lastMatchEnd, newDataLength),
+                    options.m_minRepeat, records);
+        });
+    }
+
+    // Wait for jobs to finish
+    while (!threader.isFinished())
+        continue;
+    threader.shutdown();
+
+    // Join the windows together in order
+    Instruction_Set instructions;
+    for (const auto& records : windowRecords)
+        instructions.m_records.insert(
+            instructions.m_records.end(), records.cbegin(), records.cend());
+
+    // INSERT data from end of the last window until the end of the buffer range
+    if (const auto sizeB = rangeB.size(); indexB < sizeB)
+        emplace_new_data(
+            indexB, rangeB.subrange(indexB, sizeB - indexB),
+            options.m_minRepeat, instructions.m_records);
+
+    return instructions;
+}
+
+/** Generate a diff instruction set from 2 ranges, copying matches within
+aligned windows. Instructions are sorted by target index. */
+Instruction_Set generate_instructions(
+    const MemoryRange& rangeA, const MemoryRange& rangeB,
+    const DiffOptions& options) {
+    size_t indexA(0ULL);
+    size_t indexB(0ULL);
+    const auto matchingRegions =
+        split_and_match_ranges(rangeA, rangeB, indexA, indexB, options);
+    return windows_to_instructions(matchingRegions, rangeB, indexB, options);
+}
+
+/** Generate a diff instruction set from a chained source and a target range
+offset into it, copying matches from anywhere in the source chained near each
+aligned window. Instructions are sorted by target index. */
+Instruction_Set generate_indexed_instructions(
+    const Window_Chains& chains, const MemoryRange& sourceMemory,
+    const MemoryRange& targetRange, const size_t& offset,
+    const DiffOptions& options) {
+    const auto matchingRegions = match_indexed_windows(
+        chains, sourceMemory, targetRange, offset, options);
+    return windows_to_instructions(
+        matchingRegions, targetRange, targetRange.size(), options);
+}
+
+/** Find blocks of new data which can be copied from anywhere in the source,
+extending each hit as far as the data keeps matching. */
+std::vector<MatchInfo> find_rolling_matches(
+    const Rolling_Hash_Index& index, const MemoryRange& sourceMemory,
+    const MemoryRange& newData) {
+    std::vector<MatchInfo> matches;
+    const auto sizeA = sourceMemory.size();
+    const auto sizeB = newData.size();
+    const auto bytesA = sourceMemory.bytes();
+    const auto bytesB = newData.bytes();
+    size_t lastMatchEnd(0ULL);
+    size_t indexB(0ULL);
+    auto value = Rolling_Hash_Index::hash(bytesB);
+    while (true) {
+        if (const auto indexA = index.find(value, &bytesB[indexB])) {
+            // Extend the match backwards, up to the previous match
+            const auto before = Kernels::commonSuffix(
+                &bytesB[indexB], &bytesA[*indexA],
+                std::min(indexB - lastMatchEnd, *indexA));
+
+            // Extend the match forwards, as far as both ranges allow
+            const auto after =
+                RollingBlockSize +
+                Kernels::commonPrefix(
+                    &bytesB[indexB + RollingBlockSize],
+                    &bytesA[*indexA + RollingBlockSize],
+                    std::min(sizeB - indexB, sizeA - *indexA) -
+                        RollingBlockSize);
+
+            // Resume searching after the match
+            matches.emplace_back(MatchInfo{
+                before + after, *indexA - before, indexB - before });
+            lastMatchEnd = indexB + after;
+            indexB = lastMatchEnd;
+            if (indexB + RollingBlockSize > sizeB)
+                break;
+            value = Rolling_Hash_Index::hash(&bytesB[indexB]);
+            continue;
+        }
+
+        // Slide the block forwards by one byte
+        if (indexB + RollingBlockSize >= sizeB)
+            break;
+        value = Rolling_Hash_Index::roll(
+            value, bytesB[indexB], bytesB[indexB + RollingBlockSize]);
+        ++indexB;
+    }
+    return matches;
+}
+
+/** Check if an instruction is an insertion large enough to search the
+source for. */
+constexpr bool is_searchable(const Instruction_Record& record) noexcept {
+    return record.m_type == 'I' && record.m_length >= RollingBlockSize;
+}
+
+/** Replace segments of insertion instructions with copies of matching data
+found anywhere in an indexed source, not just within the same window. */
+void insertions_to_copies(
+    Instruction_Set& baseInstructions, const Rolling_Hash_Index& index,
+    const MemoryRange& sourceMemory, const MemoryRange& targetMemory,
+    const DiffOptions& options) {
+    // Ensure the source has at least one block to copy from
+    if (sourceMemory.size() < RollingBlockSize)
+        return;
+
+    // Search every large enough insertion in a separate thread
+    const auto& records = baseInstructions.m_records;
+    const auto instructionCount = records.size();
+    std::vector<std::vector<MatchInfo>> matches(instructionCount);
+    Threader threader(thread_count(options));
+    for (size_t x = 0ULL; x < instructionCount; ++x) {
+        if (!is_searchable(records[x]))
+            continue;
+        threader.addJob([&, x]() {
+            matches[x] = find_rolling_matches(
+                index, sourceMemory,
+                targetMemory.subrange(records[x].m_index, records[x].m_length));
+        });
+    }
+
+    // Wait for jobs to finish
+    while (!threader.isFinished())
+        continue;
+    threader.shutdown();
+
+    // Split insertions around their matches, keeping everything else as-is
+    std::vector<Instruction_Record> newRecords;
+    newRecords.reserve(instructionCount);
+    for (size_t x = 0ULL; x < instructionCount; ++x) {
+        const auto& record = records[x];
+        if (matches[x].empty()) {
+            newRecords.emplace_back(record);
+            continue;
+        }
+        size_t lastMatchEnd(0ULL);
+        for (const auto& matchInfo : matches[x]) {
+            // INSERT data from end of the last match until now
+            if (const auto newDataLength = matchInfo.start2 - lastMatchEnd;
+                newDataLength > 0ULL)
+                emplace_insertion(
+                    record.m_index + lastMatchEnd, newDataLength, newRecords);
+
+            // COPY data in matching region
+            emplace_copy(
+                record.m_index + matchInfo.start2, matchInfo.start1,
+                matchInfo.start1 + matchInfo.length, newRecords);
+            lastMatchEnd = matchInfo.start2 + matchInfo.length;
+        }
+
+        // INSERT data from end of the last match until the insertion's end
+        if (const auto newDataLength = record.m_length - lastMatchEnd;
+            newDataLength > 0ULL)
+            emplace_insertion(
+                record.m_index + lastMatchEnd, newDataLength, newRecords);
+    }
+    baseInstructions.m_records = std::move(newRecords);
+}
+
+/** Replace segments of insertion instructions with copies of matching data
+found anywhere in the source, indexing it only if there's something to
+search for. */
+void insertions_to_copies(
+    Instruction_Set& baseInstructions, const MemoryRange& sourceMemory,
+    const MemoryRange& targetMemory, const DiffOptions& options) {
+    const auto& records = baseInstructions.m_records;
+    if (sourceMemory.size() < RollingBlockSize ||
+        std::none_of(records.cbegin(), records.cend(), is_searchable))
+        return;
+    const Rolling_Hash_Index index(
+        sourceMemory, options.m_memoryBudget / sizeof(size_t));
+    insertions_to_copies(
+        baseInstructions, index, sourceMemory, targetMemory, options);
+}
+
+/** Find the start or end index of each character's suffix bucket. */
+template <typename Index, typename Text>
+void suffix_buckets(
+    const Text& text, const Index& size, std::vector<Index>& buckets,
+    const bool& ends) {
+    std::fill(buckets.begin(), buckets.end(), static_cast<Index>(0));
+    for (Index index = 0; index < size; ++index)
+        ++buckets[text(index)];
+    Index sum(0);
+    for (auto& bucket : buckets) {
+        sum += bucket;
+        bucket = ends ? sum : sum - bucket;
+    }
+}
+
+/** Text of LMS substring names, reduced from a longer text. */
+template <typename Index> struct Reduced_Text {
+    const Index* m_text = nullptr;
+    Index operator()(const Index& index) const noexcept {
+        return m_text[index];
+    }
+};
+
+/** Sort the suffixes of a text with SA-IS, the text ending in a unique
+sentinel smaller than every other character. */
+template <typename Index, typename Text>
+void suffix_sort(
+    const Text& text, Index* const suffixArray, const Index& size,
+    const Index& alphabetSize) {
+    constexpr Index Empty(-1);
+    if (size == 1) {
+        suffixArray[0] = 0;
+        return;
+    }
+
+    // Classify each suffix as S-type (true) or L-type (false)
+    std::vector<bool> types(static_cast<size_t>(size));
+    types[size - 1] = true;
+    for (Index index = size - 2; index >= 0; --index)
+        types[index] =
+            text(index) < text(index + 1) ||
+            (text(index) == text(index + 1) && types[index + 1]);
+    const auto is_lms = [&](const Index& index) {
+        return index > 0 && types[index] && !types[index - 1];
+    };
+
+    // Induce the order of L-type then S-type suffixes from sorted seeds
+    std::vector<Index> buckets(static_cast<size_t>(alphabetSize));
+    const auto induce = [&]() {
+        suffix_buckets(text, size, buckets, false);
+        for (Index index = 0; index < size; ++index)
+            if (const auto prior = suffixArray[index] - 1;
+                suffixArray[index] > 0 && !types[prior])
+                suffixArray[buckets[text(prior)]++] = prior;
+        suffix_buckets(text, size, buckets, true);
+        for (Index index = size - 1; index >= 0; --index)
+            if (const auto prior = suffixArray[index] - 1;
+                suffixArray[index] > 0 && types[prior])
+                suffixArray[--buckets[text(prior)]] = prior;
+    };
+
+    // Sort the LMS substrings by inducing from their bucket ends
+    suffix_buckets(text, size, buckets, true);
+    std::fill(suffixArray, suffixArray + size, Empty);
+    for (Index index = 1; index < size; ++index)
+        if (is_lms(index))
+            suffixArray[--buckets[text(index)]] = index;
+    induce();
+
+    // Compact the sorted LMS substrings into the front of the array
+    Index lmsCount(0);
+    for (Index index = 0; index < size; ++index)
+        if (is_lms(suffixArray[index]))
+            suffixArray[lmsCount++] = suffixArray[index];
+
+    // Name each LMS substring, equal substrings sharing a name
+    std::fill(suffixArray + lmsCount, suffixArray + size, Empty);
+    Index nameCount(0);
+    Index previous(Empty);
+    for (Index index = 0; index < lmsCount; ++index) {
+        const auto position = suffixArray[index];
+        bool different(false);
+        for (Index offset = 0;; ++offset) {
+            if (previous == Empty ||
+                text(position + offset) != text(previous + offset) ||
+                types[position + offset] != types[previous + offset]) {
+                different = true;
+                break;
+            }
+            if (offset > 0 &&
+                (is_lms(position + offset) || is_lms(previous + offset)))
+                break;
+        }
+        if (different) {
+            ++nameCount;
+            previous = position;
+        }
+        suffixArray[lmsCount + (position / 2)] = nameCount - 1;
+    }
+    for (Index index = size - 1, target = size - 1; index >= lmsCount;
+         --index)
+        if (suffixArray[index] != Empty)
+            suffixArray[target--] = suffixArray[index];
+
+    // Sort the reduced text, recursing if any names repeat
+    Index* const reducedText = suffixArray + size - lmsCount;
+    if (nameCount < lmsCount)
+        suffix_sort(
+            Reduced_Text<Index>{ reducedText }, suffixArray, lmsCount,
+            nameCount);
+    else
+        for (Index index = 0; index < lmsCount; ++index)
+            suffixArray[reducedText[index]] = index;
+
+    // Map the sorted reduced suffixes back onto LMS positions in the text
+    for (Index index = 1, target = 0; index < size; ++index)
+        if (is_lms(index))
+            reducedText[target++] = index;
+    for (Index index = 0; index < lmsCount; ++index)
+        suffixArray[index] = reducedText[suffixArray[index]];
+
+    // Seed the buckets with the sorted LMS suffixes, inducing the rest
+    std::fill(suffixArray + lmsCount, suffixArray + size, Empty);
+    suffix_buckets(text, size, buckets, true);
+    for (Index index = lmsCount - 1; index >= 0; --index) {
+        const auto position = suffixArray[index];
+        suffixArray[index] = Empty;
+        suffixArray[--buckets[text(position)]] = position;
+    }
+    induce();
+}
+
+/** Find the longest match for the start of a target range within the source,
+by binary searching the source's suffix array. */
+template <typename Index>
+size_t find_longest_suffix(
+    const std::vector<Index>& suffixArray, const MemoryRange& sourceMemory,
+    const MemoryRange& targetMemory, size_t& position) {
+    const auto sizeA = sourceMemory.size();
+    const auto sizeB = targetMemory.size();
+    const auto match_length = [&](const Index& suffix) {
+        const auto indexA = static_cast<size_t>(suffix);
+        return Kernels::commonPrefix(
+            &sourceMemory.bytes()[indexA], targetMemory.bytes(),
+            std::min(sizeA - indexA, sizeB));
+    };
+
+    // Narrow down to the 2 suffixes surrounding the target
+    size_t begin(0ULL);
+    size_t end(suffixArray.size() - 1ULL);
+    while (end - begin >= 2ULL) {
+        const auto middle = begin + ((end - begin) / 2ULL);
+        const auto indexA = static_cast<size_t>(suffixArray[middle]);
+        if (std::memcmp(
+                &sourceMemory.bytes()[indexA], targetMemory.bytes(),
+                std::min(sizeA - indexA, sizeB)) < 0)
+            begin = middle;
+        else
+            end = middle;
+    }
+
+    // Use whichever of the 2 matches the target for longer
+    const auto lengthBegin = match_length(suffixArray[begin]);
+    const auto lengthEnd = match_length(suffixArray[end]);
+    if (lengthBegin > lengthEnd) {
+        position = static_cast<size_t>(suffixArray[begin]);
+        return lengthBegin;
+    }
+    position = static_cast<size_t>(suffixArray[end]);
+    return lengthEnd;
+}
+
+/** Generate and emplace a new add instruction, or a copy if nothing differs. */
+void emplace_addition(
+    const size_t& index, const size_t& beginRead, const MemoryRange& oldRange,
+    const MemoryRange& newRange, Instruction_Set& instructions) {
+    // Copy the segment instead if it matches exactly
+    if (std::equal(newRange.cbegin(), newRange.cend(), oldRange.cbegin())) {
+        emplace_copy(
+            index, beginRead, beginRead + newRange.size(),
+            instructions.m_records);
+        return;
+    }
+
+    // Append the byte-wise differences to the literal pool
+    auto& literals = instructions.m_literals;
+    const auto literal = literals.size();
+    literals.resize(literal + newRange.size());
+    std::transform(
+        newRange.cbegin(), newRange.cend(), oldRange.cbegin(),
+        &literals[literal],
+        [](const std::byte& newValue, const std::byte& oldValue) noexcept {
+            return static_cast<std::byte>(
+                static_cast<unsigned char>(newValue) -
+                static_cast<unsigned char>(oldValue));
+        });
+
+    // Emplace instruction back in vector
+    instructions.m_records.emplace_back(Instruction_Record{
+        'A', 0ULL, index, newRange.size(), beginRead, literal });
+}
+
+/** Sort every suffix of a range, with a sentinel for the empty suffix. */
+template <typename Index>
+std::vector<Index> sort_suffixes(const MemoryRange& memoryRange) {
+    const auto bytes = memoryRange.bytes();
+    std::vector<Index> suffixArray(memoryRange.size() + 1ULL);
+    const auto sentinel = static_cast<Index>(memoryRange.size());
+    suffix_sort(
+        [bytes, sentinel](const Index& index) noexcept {
+            return index == sentinel ? static_cast<Index>(0)
+                                     : static_cast<Index>(bytes[index]) + 1;
+        },
+        suffixArray.data(), sentinel + 1, static_cast<Index>(257));
+    return suffixArray;
+}
+
+/** Generate a diff instruction set from 2 ranges, like bsdiff.
+Matches are found by searching a suffix array of range A, then extended in
+either direction while at least half their bytes match, storing byte-wise
+differences which compress far better than insertions. */
+template <typename Index>
+Instruction_Set generate_suffix_instructions(
+    const std::vector<Index>& suffixArray, const MemoryRange& rangeA,
+    const MemoryRange& rangeB, const size_t& minRepeat) {
+    Instruction_Set instructions;
+    const auto sizeA = rangeA.size();
+    const auto sizeB = rangeB.size();
+    const auto bytesA = rangeA.bytes();
+    const auto bytesB = rangeB.bytes();
+
+    // Check if a byte of range B matches range A along the last match
+    int64_t lastOffset(0LL);
+    const auto matches_last_offset = [&](const size_t& indexB) noexcept {
+        const auto indexA = static_cast<int64_t>(indexB) + lastOffset;
+        return indexA >= 0LL && indexA < static_cast<int64_t>(sizeA) &&
+               bytesA[indexA] == bytesB[indexB];
+    };
+
+    size_t scan(0ULL);
+    size_t length(0ULL);
+    size_t position(0ULL);
+    size_t lastScan(0ULL);
+    size_t lastPosition(0ULL);
+    while (scan < sizeB) {
+        // Find the next match that isn't mostly a continuation of the last
+        int64_t oldScore(0LL);
+        for (size_t scoreScan = scan += length; scan < sizeB; ++scan) {
+            length = find_longest_suffix(
+                suffixArray, rangeA, rangeB.subrange(scan, sizeB - scan),
+                position);
+            for (; scoreScan < scan + length; ++scoreScan)
+                if (matches_last_offset(scoreScan))
+                    ++oldScore;
+            const auto score = static_cast<int64_t>(length);
+            if ((score == oldScore && length != 0ULL) || score > oldScore + 8)
+                break;
+            if (matches_last_offset(scan))
+                --oldScore;
+        }
+        if (static_cast<int64_t>(length) == oldScore && scan != sizeB)
+            continue;
+
+        // Extend the last match forwards, while most of its bytes match
+        int64_t matchCount(0LL);
+        int64_t bestCount(0LL);
+        size_t lengthForward(0ULL);
+        for (size_t x = 0ULL;
+             lastScan + x < scan && lastPosition + x < sizeA;) {
+            if (bytesA[lastPosition + x] == bytesB[lastScan + x])
+                ++matchCount;
+            ++x;
+            if ((matchCount * 2) - static_cast<int64_t>(x) >
+                (bestCount * 2) - static_cast<int64_t>(lengthForward)) {
+                bestCount = matchCount;
+                lengthForward = x;
+            }
+        }
+
+        // Extend the new match backwards, while most of its bytes match
+        size_t lengthBackward(0ULL);
+        if (scan < sizeB) {
+            matchCount = 0LL;
+            bestCount = 0LL;
+            for (size_t x = 1ULL; scan >= lastScan + x && position >= x; ++x) {
+                if (bytesA[position - x] == bytesB[scan - x])
+                    ++matchCount;
+                if ((matchCount * 2) - static_cast<int64_t>(x) >
+                    (bestCount * 2) - static_cast<int64_t>(lengthBackward)) {
+                    bestCount = matchCount;
+                    lengthBackward = x;
+                }
+            }
+        }
+
+        // Split any overlap between both extensions where it scores best
+        if (lastScan + lengthForward > scan - lengthBackward) {
+            const auto overlap =
+                (lastScan + lengthForward) - (scan - lengthBackward);
+            matchCount = 0LL;
+            bestCount = 0LL;
+            size_t lengthSplit(0ULL);
+            for (size_t x = 0ULL; x < overlap; ++x) {
+                const auto forward = lengthForward - overlap + x;
+                if (bytesB[lastScan + forward] ==
+                    bytesA[lastPosition + forward])
+                    ++matchCount;
+                if (bytesB[scan - lengthBackward + x] ==
+                    bytesA[position - lengthBackward + x])
+                    --matchCount;
+                if (matchCount > bestCount) {
+                    bestCount = matchCount;
+                    lengthSplit = x + 1ULL;
+                }
+            }
+            lengthForward += lengthSplit - overlap;
+            lengthBackward -= lengthSplit;
+        }
+
+        // ADD the differences along the forwards extension
+        if (lengthForward > 0ULL)
+            emplace_addition(
+                lastScan, lastPosition,
+                rangeA.subrange(lastPosition, lengthForward),
+                rangeB.subrange(lastScan, lengthForward), instructions);
+
+        // INSERT data between both extensions
+        const auto insertBegin = lastScan + lengthForward;
+        const auto insertEnd = scan - lengthBackward;
+        if (insertEnd > insertBegin)
+            emplace_new_data(
+                insertBegin,
+                rangeB.subrange(insertBegin, insertEnd - insertBegin),
+                minRepeat, instructions.m_records);
+
+        // Continue from the start of the backwards extension
+        lastScan = scan - lengthBackward;
+        lastPosition = position - lengthBackward;
+        lastOffset =
+            static_cast<int64_t>(position) - static_cast<int64_t>(scan);
+    }
+    return instructions;
+}
+
+/** Merge neighbouring instructions which continue one another, such as
+copies split across window boundaries. */
+void coalesce_instructions(
+    Instruction_Set& instructions, const MemoryRange& targetMemory) {
+    auto& records = instructions.m_records;
+    if (records.empty())
+        return;
+    size_t last(0ULL);
+    for (size_t x = 1ULL; x < records.size(); ++x) {
+        auto& previous = records[last];
+        const auto& record = records[x];
+        const auto length = previous.m_length;
+        const auto continues =
+            previous.m_type == record.m_type &&
+            previous.m_base == record.m_base &&
+            previous.m_index + length == record.m_index &&
+            (record.m_type == 'I' ||
+             ((record.m_type == 'R' || record.m_type == 'P') &&
+              previous.m_period == record.m_period &&
+              std::memcmp(
+                  &targetMemory.bytes()[record.m_index],
+                  &targetMemory.bytes()[record.m_index - record.m_period],
+                  record.m_period) == 0) ||
+             (record.m_type == 'C' &&
+              previous.m_beginRead + length == record.m_beginRead) ||
+             (record.m_type == 'A' &&
+              previous.m_beginRead + length == record.m_beginRead &&
+              previous.m_literal + length == record.m_literal));
+        if (continues)
+            previous.m_length += record.m_length;
+        else
+            records[++last] = record;
+    }
+    records.resize(last + 1ULL);
+}
+
+/** Order instructions so a patch may overwrite its own source, like in-place
+bsdiff. Copies and additions must run before anything overwrites what they
+read, so they're sorted topologically by those dependencies, converting the
+shortest to insertions where dependencies form a cycle. Instructions that
+don't read the source run last. Expects instructions sorted by target index. */
+void order_in_place(Instruction_Set& instructions) {
+    // Additions are applied front to back, so can't write ahead of what they
+    // read. Split them into pieces no longer than that distance, which are
+    // then ordered back to front, unless the pieces would be too short.
+    auto& records = instructions.m_records;
+    std::vector<Instruction_Record> splitRecords;
+    splitRecords.reserve(records.size());
+    for (const auto& record : records) {
+        const auto distance = record.m_index - record.m_beginRead;
+        if (record.m_type != 'A' || record.m_index <= record.m_beginRead ||
+            distance >= record.m_length) {
+            splitRecords.emplace_back(record);
+            continue;
+        }
+        if (distance < MinInPlacePiece) {
+            splitRecords.emplace_back(record).m_type = 'I';
+            continue;
+        }
+        for (size_t offset = 0ULL; offset < record.m_length;
+             offset += distance) {
+            auto& piece = splitRecords.emplace_back(record);
+            piece.m_index += offset;
+            piece.m_length = std::min(distance, record.m_length - offset);
+            piece.m_beginRead += offset;
+            piece.m_literal += offset;
+        }
+    }
+    records = std::move(splitRecords);
+    std::vector<size_t> readers;
+    for (size_t x = 0ULL; x < records.size(); ++x)
+        if (records[x].m_type == 'C' || records[x].m_type == 'A')
+            readers.push_back(x);
+
+    // Each reader must precede those overwriting what it reads, which are
+    // contiguous as instructions never overlap in the target
+    const auto readerCount = readers.size();
+    std::vector<std::pair<size_t, size_t>> overwriters(readerCount);
+    std::vector<size_t> readerCounts(readerCount, 0ULL);
+    for (size_t x = 0ULL; x < readerCount; ++x) {
+        const auto& record = records[readers[x]];
+        const auto readEnd = record.m_beginRead + record.m_length;
+        const auto first = std::partition_point(
+            readers.cbegin(), readers.cend(), [&](const size_t& reader) {
+                return records[reader].m_index + records[reader].m_length <=
+                       record.m_beginRead;
+            });
+        const auto last = std::partition_point(
+            first, readers.cend(), [&](const size_t& reader) {
+                return records[reader].m_index < readEnd;
+            });
+        overwriters[x] = { static_cast<size_t>(first - readers.cbegin()),
+                           static_cast<size_t>(last - readers.cbegin()) };
+        for (auto y = overwriters[x].first; y < overwriters[x].second; ++y)
+            if (y != x)
+                ++readerCounts[y];
+    }
+
+    // Emit readers once nothing still reads what they overwrite
+    std::vector<size_t> ready;
+    for (size_t x = 0ULL; x < readerCount; ++x)
+        if (readerCounts[x] == 0ULL)
+            ready.push_back(x);
+    std::vector<size_t> byLength(readerCount);
+    std::iota(byLength.begin(), byLength.end(), 0ULL);
+    std::stable_sort(
+        byLength.begin(), byLength.end(),
+        [&](const size_t& a, const size_t& b) noexcept {
+            return records[readers[a]].m_length <
+                   records[readers[b]].m_length;
+        });
+    std::vector<bool> finished(readerCount, false);
+    std::vector<Instruction_Record> orderedRecords;
+    orderedRecords.reserve(records.size());
+    for (size_t finishedCount = 0ULL, shortest = 0ULL;
+         finishedCount < readerCount; ++finishedCount) {
+        // Break cycles by inserting the shortest remaining reader instead
+        size_t x(0ULL);
+        while (!ready.empty() && finished[ready.back()])
+            ready.pop_back();
+        if (ready.empty()) {
+            while (finished[byLength[shortest]])
+                ++shortest;
+            x = byLength[shortest];
+            records[readers[x]].m_type = 'I';
+        } else {
+            x = ready.back();
+            ready.pop_back();
+            orderedRecords.emplace_back(records[readers[x]]);
+        }
+
+        // Release the readers it would have overwritten
+        finished[x] = true;
+        for (auto y = overwriters[x].first; y < overwriters[x].second; ++y)
+            if (y != x && --readerCounts[y] == 0ULL && !finished[y])
+                ready.push_back(y);
+    }
+
+    // Follow with every instruction writing new data
+    for (const auto& record : records)
+        if (record.m_type != 'C' && record.m_type != 'A')
+            orderedRecords.emplace_back(record);
+    records = std::move(orderedRecords);
+}
+
+/** The prefix and suffix 2 ranges share, and the middles left of each. */
+struct Trimmed_Ranges {
+    size_t m_prefix = 0ULL, m_suffix = 0ULL;
+    MemoryRange m_sourceMiddle, m_targetMiddle;
+};
+
+/** Trim the prefix and suffix 2 ranges share, so only what lies between
+them is matched, and identical ranges aren't matched at all. */
+Trimmed_Ranges trim_ranges(
+    const MemoryRange& sourceMemory, const MemoryRange& targetMemory) {
+    const auto sharedSize = std::min(sourceMemory.size(), targetMemory.size());
+    const auto prefix = Kernels::commonPrefix(
+        sourceMemory.bytes(), targetMemory.bytes(), sharedSize);
+    const auto suffix = Kernels::commonSuffix(
+        &sourceMemory.bytes()[sourceMemory.size()],
+        &targetMemory.bytes()[targetMemory.size()], sharedSize - prefix);
+    return Trimmed_Ranges{
+        prefix, suffix,
+        MemoryRange(
+            sourceMemory.size() - prefix - suffix,
+            &sourceMemory.bytes()[prefix]),
+        MemoryRange(
+            targetMemory.size() - prefix - suffix,
+            &targetMemory.bytes()[prefix])
+    };
+}
+
+/** Shift instructions generated for the middle of a trimmed target past its
+prefix, and their source offsets too if they were read from the middle of
+the source, then copy the prefix and suffix around them. */
+void untrim_instructions(
+    Instruction_Set& instructions, const Trimmed_Ranges& trimmed,
+    const MemoryRange& sourceMemory, const MemoryRange& targetMemory,
+    const bool& fromSourceMiddle) {
+    const auto& prefix = trimmed.m_prefix;
+    const auto& suffix = trimmed.m_suffix;
+    auto& records = instructions.m_records;
+    for (auto& record : records) {
+        record.m_index += prefix;
+        if (fromSourceMiddle &&
+            (record.m_type == 'C' || record.m_type == 'A'))
+            record.m_beginRead += prefix;
     }
+    if (prefix != 0ULL)
+        records.insert(
+            records.cbegin(),
+            Instruction_Record{ 'C', 0ULL, 0ULL, prefix, 0ULL, 0ULL });
+    if (suffix != 0ULL)
+        emplace_copy(
+            targetMemory.size() - suffix, sourceMemory.size() - suffix,
+            sourceMemory.size(), records);
+}
 
-    // Wait for jobs to finish
-    while (!threader.isFinished())
-        continue;
+/** Check if a source should be matched with a suffix array, which needs
+about twice its own size while sorting. Suffix arrays use 32-bit indices
+unless the source is too large. */
+bool use_suffix_array(
+    const MemoryRange& sourceMemory, const DiffOptions& options) noexcept {
+    const auto indexSize = sourceMemory.size() < static_cast<size_t>(INT32_MAX)
+                               ? sizeof(int32_t)
+                               : sizeof(int64_t);
+    return options.m_mode == DiffMode::HIGH_RATIO &&
+           (options.m_memoryBudget == 0ULL ||
+            (sourceMemory.size() + 1ULL) * 2ULL * indexSize <=
+                options.m_memoryBudget);
+}
 
-    return matchingRegions;
+/** Generate the instructions for a target from a source, trimming what they
+share, then matching what lies between with the strategy supplied. */
+Instruction_Set diff_instructions(
+    const MemoryRange& sourceMemory, const MemoryRange& targetMemory,
+    const DiffOptions& options) {
+    // Convert matching regions into diff instructions, sorted by target index
+    const auto trimmed = trim_ranges(sourceMemory, targetMemory);
+    const auto& sourceMiddle = trimmed.m_sourceMiddle;
+    const auto& targetMiddle = trimmed.m_targetMiddle;
+    Instruction_Set instructions;
+    if (!targetMiddle.empty() && use_suffix_array(sourceMiddle, options)) {
+        if (sourceMiddle.size() < static_cast<size_t>(INT32_MAX))
+            instructions = generate_suffix_instructions(
+                sort_suffixes<int32_t>(sourceMiddle), sourceMiddle,
+                targetMiddle, options.m_minRepeat);
+        else
+            instructions = generate_suffix_instructions(
+                sort_suffixes<int64_t>(sourceMiddle), sourceMiddle,
+                targetMiddle, options.m_minRepeat);
+    } else if (!targetMiddle.empty()) {
+        instructions =
+            generate_instructions(sourceMiddle, targetMiddle, options);
+
+        // Replace insertions with copies found anywhere in the source
+        coalesce_instructions(instructions, targetMiddle);
+        insertions_to_copies(
+            instructions, sourceMiddle, targetMiddle, options);
+    }
+    untrim_instructions(
+        instructions, trimmed, sourceMemory, targetMemory, true);
+    return instructions;
 }
 
-/** Generate and emplace a new insertion instruction. */
-void emplace_insertion(
-    const size_t& index, const MemoryRange& range, std::mutex& mutex,
-    std::vector<std::unique_ptr<Differential_Instruction>>& instructions) {
-    // Make an instruction from input arguments
-    auto inst = std::make_unique<Insert_Instruction>();
-    inst->m_index = index;
-    inst->m_newData.resize(range.size());
+/** Split the copies and additions of instructions generated against bases
+laid end to end, wherever they cross from one base into the next, so each
+reads from a single base. */
+void split_across_bases(
+    Instruction_Set& instructions, const std::vector<size_t>& baseSizes) {
+    std::vector<size_t> baseBegins(baseSizes.size() + 1ULL, 0ULL);
+    std::partial_sum(
+        baseSizes.cbegin(), baseSizes.cend(), std::next(baseBegins.begin()));
+    std::vector<Instruction_Record> records;
+    records.reserve(instructions.m_records.size());
+    for (auto record : instructions.m_records) {
+        if (record.m_type != 'C' && record.m_type != 'A') {
+            records.emplace_back(record);
+            continue;
+        }
+        while (record.m_length != 0ULL) {
+            // Find the last base beginning at or before the read, skipping
+            // any empty bases beginning there too
+            const auto base = static_cast<size_t>(
+                std::distance(
+                    baseBegins.cbegin(),
+                    std::upper_bound(
+                        baseBegins.cbegin(), std::prev(baseBegins.cend()),
+                        record.m_beginRead)) -
+                1);
+            const auto length = std::min(
+                record.m_length, baseBegins[base + 1ULL] - record.m_beginRead);
+            auto piece = record;
+            piece.m_length = length;
+            piece.m_beginRead -= baseBegins[base];
+            piece.m_base = base;
+            records.emplace_back(piece);
+            record.m_index += length;
+            record.m_beginRead += length;
+            record.m_length -= length;
+            if (record.m_type == 'A')
+                record.m_literal += length;
+        }
+    }
+    instructions.m_records = std::move(records);
+}
 
-    // Copy buffer data
-    std::copy(range.cbegin(), range.cend(), inst->m_newData.begin());
+/** Compress the instructions of a diff and prepend its header, followed by
+the size of each base for diffs against several.
+@return                 the diff buffer on success, empty otherwise. */
+std::optional<Buffer> package_diff(
+    Buffer& patchBuffer, const DifferentialHeader& diffHeader,
+    const std::vector<size_t>& baseSizes) {
+    // Try to compress the patch buffer, in blocks when it may be streamed
+    if (auto result =
+            patchBuffer.size() > PatchBlockSize
+                ? Buffer::compress_seekable(patchBuffer, PatchBlockSize)
+                : patchBuffer.compress())
+        std::swap(patchBuffer, *result);
+    else
+        return {}; // Failure
 
-    // Emplace instruction back in vector
-    std::unique_lock<std::mutex> writeGuard(mutex);
-    instructions.emplace_back(std::move(inst));
-}
+    // Prepend header information
+    constexpr size_t headerSize = sizeof(DifferentialHeader);
+    const auto baseTableSize = baseSizes.empty()
+                                   ? 0ULL
+                                   : (baseSizes.size() + 1ULL) * sizeof(size_t);
+    Buffer bufferWithHeader;
+    bufferWithHeader.reserve(patchBuffer.size() + headerSize + baseTableSize);
 
-/** Generate and emplace a new copy instruction. */
-void emplace_copy(
-    const size_t& index, const size_t& beginRead, const size_t& endRead,
-    std::mutex& mutex,
-    std::vector<std::unique_ptr<Differential_Instruction>>& instructions) {
-    // Make an instruction from input arguments
-    auto inst = std::make_unique<Copy_Instruction>();
-    inst->m_index = index;
-    inst->m_beginRead = beginRead;
-    inst->m_endRead = endRead;
+    // Copy header data into new buffer at the beginning
+    bufferWithHeader.push_type(diffHeader);
+    if (!baseSizes.empty()) {
+        bufferWithHeader.push_type(baseSizes.size());
+        for (const auto& baseSize : baseSizes)
+            bufferWithHeader.push_type(baseSize);
+    }
+    bufferWithHeader.push_raw(patchBuffer.bytes(), patchBuffer.size());
 
-    // Emplace instruction back in vector
-    std::unique_lock<std::mutex> writeGuard(mutex);
-    instructions.emplace_back(std::move(inst));
+    return bufferWithHeader; // Success
 }
 
-/** Generate a diff instruction set from 2 ranges. */
-auto generate_instructions(
-    const MemoryRange& rangeA, const MemoryRange& rangeB) {
-    std::vector<std::unique_ptr<Differential_Instruction>> instructions;
-    std::mutex instructionMutex;
-    Threader threader;
-    size_t indexA(0ULL);
-    size_t indexB(0ULL);
-    for (const auto& matchRegion :
-         split_and_match_ranges(rangeA, rangeB, indexA, indexB)) {
-        threader.addJob([&, matchRegion]() {
-            const auto& [windowInfo, matches] = matchRegion;
-            size_t lastMatchEnd(windowInfo.indexB);
-            for (auto& matchInfo : matches) {
-                // INSERT data from end of the last match until now
-                const auto newDataLength = matchInfo.start2 - lastMatchEnd;
-                if (newDataLength > 0ULL)
-                    emplace_insertion(
-                        lastMatchEnd,
-                        rangeB.subrange(lastMatchEnd, newDataLength),
-                        instructionMutex, instructions);
-
-                // COPY data in matching region
-                emplace_copy(
-                    matchInfo.start2, matchInfo.start1,
-                    matchInfo.start1 + matchInfo.length, instructionMutex,
-                    instructions);
-                lastMatchEnd = matchInfo.start2 + matchInfo.length;
-            }
+/** Write-out a diff of a target from its instructions, compressing them and
+prepending a header. Diffs against several bases follow it with the size of
+each base, and switch between bases as their instructions need. */
+std::optional<Buffer> write_diff(
+    Instruction_Set& instructions, const MemoryRange& targetMemory,
+    const DiffOptions& options, const std::vector<size_t>& baseSizes = {}) {
+    coalesce_instructions(instructions, targetMemory);
+    if (options.m_inPlace)
+        order_in_place(instructions);
 
-            // INSERT data from end of the last match until window end
-            const auto newDataLength =
-                (windowInfo.indexB + windowInfo.windowSize) - lastMatchEnd;
-            if (newDataLength > 0ULL)
-                emplace_insertion(
-                    lastMatchEnd, rangeB.subrange(lastMatchEnd, newDataLength),
-                    instructionMutex, instructions);
+    // Create a buffer to contain all the diff instructions
+    const auto& records = instructions.m_records;
+    const auto size_patch = std::accumulate(
+        records.cbegin(), records.cend(), 0ULL,
+        [](const auto& currentSum, const auto& record) noexcept {
+            return currentSum + record_size(record);
         });
+    Buffer patchBuffer;
+    patchBuffer.reserve(size_patch);
+
+    // Write the instructions in order, target order keeps positions implicit
+    Differential_Cursor cursor;
+    std::vector<size_t> baseEnds(baseSizes.size());
+    size_t base(0ULL);
+    for (const auto& record : records) {
+        // Switch bases when needed, each resuming where it was last read
+        if ((record.m_type == 'C' || record.m_type == 'A') &&
+            record.m_base != base) {
+            patchBuffer.push_type('B');
+            push_varint(patchBuffer, record.m_base);
+            baseEnds[base] = cursor.m_sourceEnd;
+            base = record.m_base;
+            cursor.m_sourceEnd = baseEnds[base];
+        }
+        // Additions carry differences, anything else carries target data
+        const auto dataBytes =
+            record.m_type == 'A'
+                ? instructions.m_literals.data() + record.m_literal
+                : targetMemory.bytes() + record.m_index;
+        write_record(record, dataBytes, patchBuffer, cursor);
     }
 
-    // INSERT data from end of the last window until the end of the buffer range
-    if (const auto sizeB = rangeB.size(); indexB < sizeB)
-        emplace_insertion(
-            indexB, rangeB.subrange(indexB, sizeB - indexB), instructionMutex,
-            instructions);
-
-    // Wait for jobs to finish
-    while (!threader.isFinished())
-        continue;
+    // Free up memory
+    instructions = Instruction_Set();
+
+    // Mark whether the diff reads several bases, or may patch in place
+    auto diffHeader =
+        options.m_inPlace
+            ? DifferentialHeader{ "yatta diff ip", targetMemory.size() }
+            : DifferentialHeader{ "yatta diff v2", targetMemory.size() };
+    if (!baseSizes.empty())
+        diffHeader = DifferentialHeader{ "yatta diff mb", targetMemory.size() };
+    return package_diff(patchBuffer, diffHeader, baseSizes);
+}
 
-    return instructions;
+/** Write-out a diff of a target from each of several bases alone, so it may
+be patched from any one of them. Each base's diff inserts whatever that base
+lacks, and follows the header and the size of each base, preceded by its own
+size.
+@return                 the diff buffer on success, empty otherwise. */
+std::optional<Buffer> write_independent_diff(
+    const std::vector<MemoryRange>& baseMemories,
+    const MemoryRange& targetMemory, const DiffOptions& options,
+    const std::vector<size_t>& baseSizes) {
+    Buffer diffBuffer;
+    diffBuffer.push_type(
+        DifferentialHeader{ "yatta diff mi", targetMemory.size() });
+    diffBuffer.push_type(baseSizes.size());
+    for (const auto& baseSize : baseSizes)
+        diffBuffer.push_type(baseSize);
+    for (const auto& baseMemory : baseMemories) {
+        auto instructions =
+            diff_instructions(baseMemory, targetMemory, options);
+        const auto baseDiff = write_diff(instructions, targetMemory, options);
+        if (!baseDiff)
+            return {}; // Failure
+        diffBuffer.push_type(baseDiff->size());
+        diffBuffer.push_raw(baseDiff->bytes(), baseDiff->size());
+    }
+    return diffBuffer; // Success
 }
 
-/** Retrieve insertion instructions larger than 36 bytes. */
-std::vector<Insert_Instruction*> get_large_insertions(
-    std::vector<std::unique_ptr<Differential_Instruction>>& instructions) {
-    // Create a vector large enough for worst-case-scenario
-    std::vector<Insert_Instruction*> largeInsertions;
-    largeInsertions.reserve(instructions.size());
+/** Writes the instructions of a composed diff in target order, merging
+neighbours which continue one another. */
+class Instruction_Writer {
+    public:
+    // Public Methods
+    /** Write an instruction, along with any data it carries. */
+    void write(
+        const Instruction_Record& record, const std::byte* const dataBytes) {
+        const auto& type = record.m_type;
+        const auto continues =
+            m_hasPending && m_pending.m_type == type &&
+            m_pending.m_index + m_pending.m_length == record.m_index &&
+            (type == 'I' || (type == 'R' && m_data.front() == *dataBytes) ||
+             ((type == 'C' || type == 'A') &&
+              m_pending.m_beginRead + m_pending.m_length ==
+                  record.m_beginRead));
+        if (continues)
+            m_pending.m_length += record.m_length;
+        else {
+            flush();
+            m_pending = record;
+            m_hasPending = true;
+        }
 
-    // Find all valid insertion instructions
-    for (const auto& instruction : instructions) {
-        // We only care about repeats larger than 36 bytes.
-        auto inst = dynamic_cast<Insert_Instruction*>(instruction.get());
-        if (inst == nullptr || inst->m_newData.size() <= 36ULL)
-            continue;
+        // Keep the data carried, repeats only needing their first value
+        size_t dataSize(0ULL);
+        if (type == 'I' || type == 'A')
+            dataSize = record.m_length;
+        else if (type == 'P')
+            dataSize = record.m_period;
+        else if (type == 'R' && !continues)
+            dataSize = sizeof(std::byte);
+        m_data.insert(m_data.cend(), dataBytes, dataBytes + dataSize);
+    }
+    /** Write-out the last instruction, then retrieve them all.
+    @return                 the encoded instructions. */
+    Buffer& finish() {
+        flush();
+        return m_buffer;
+    }
 
-        // Use this instruction
-        largeInsertions.emplace_back(inst);
+    private:
+    // Private Methods
+    /** Write-out the instruction pending, if any. */
+    void flush() {
+        if (m_hasPending)
+            write_record(m_pending, m_data.data(), m_buffer, m_cursor);
+        m_hasPending = false;
+        m_data.clear();
     }
 
-    return largeInsertions;
-}
+    // Private Attributes
+    Instruction_Record m_pending;
+    std::vector<std::byte> m_data;
+    bool m_hasPending = false;
+    Buffer m_buffer;
+    Differential_Cursor m_cursor;
+};
 
-/** Find the last common value in a repeating series. */
-size_t
-find_last_in_series(const std::byte& value, const MemoryRange& range) noexcept {
-    // Compare 8-byte-wise
-    size_t index(0ULL);
-    const std::byte value_array[8] = { value, value, value, value,
-                                       value, value, value, value };
-    const auto& value_8 = *reinterpret_cast<const size_t*>(&value_array[0]);
-    const auto* const range_8 = reinterpret_cast<const size_t*>(range.bytes());
-    const size_t size(range.size());
-    const size_t max(size / 8ULL);
-    for (; index < max; ++index)
-        if (range_8[index] != value_8)
-            break;
+/** A single-source diff, indexed in the order it writes its target. */
+struct Indexed_Diff {
+    /** The size of the target the diff writes. */
+    size_t m_targetSize = 0ULL;
+    /** The expanded instructions, holding the data records point to. */
+    Patch_Reader m_reader;
+    /** Every instruction writing any bytes, sorted by where they write. */
+    std::vector<Patch_Record> m_records;
+};
 
-    // Compare 1-byte-wise
-    const auto range_1 = range.bytes();
-    index *= 8ULL;
-    for (; index < size; ++index)
-        if (range_1[index] != value)
-            break;
+/** Index a single-source diff by where its instructions write. Its source
+isn't read, only validated against, and none of its instructions may
+overwrite another.
+@return                 the indexed diff on success, empty otherwise. */
+std::optional<Indexed_Diff>
+index_diff(const MemoryRange& diffMemory, const size_t& sourceSize) {
+    // Ensure diff buffer at least holds a header
+    constexpr size_t diffHeaderSize = sizeof(DifferentialHeader);
+    if (diffMemory.size() < diffHeaderSize)
+        return {}; // Failure
 
-    return index;
-}
+    // Read in header, ensuring the diff has a single source
+    DifferentialHeader header;
+    diffMemory.out_type(header);
+    const auto legacy = std::strcmp(header.m_title, "yatta diff") == 0;
+    if (!legacy && std::strcmp(header.m_title, "yatta diff v2") != 0 &&
+        std::strcmp(header.m_title, "yatta diff ip") != 0)
+        return {}; // Failure
 
-/** Split an insertion instruction into two insertions and a repeat. */
-void split_insertion(
-    Insert_Instruction* const& inst, const size_t& startIndex,
-    const size_t& endIndex, const std::byte& value_at_x,
-    std::vector<std::unique_ptr<Differential_Instruction>>& instructions,
-    std::mutex& mutex) {
-    // Keep data up until region where repeats occur
-    Insert_Instruction instBefore;
-    instBefore.m_index = inst->m_index;
-    instBefore.m_newData.resize(startIndex);
-    std::copy(
-        inst->m_newData.data(), inst->m_newData.data() + startIndex,
-        instBefore.m_newData.data());
-
-    // Generate new Repeat Instruction
-    Repeat_Instruction instRepeat;
-    const auto length = endIndex - startIndex;
-    instRepeat.m_index = inst->m_index + startIndex;
-    instRepeat.m_value = value_at_x;
-    instRepeat.m_amount = length;
-
-    // Retain remainder of insertion data
-    const auto size = inst->m_newData.size();
-    inst->m_index = inst->m_index + startIndex + length;
-    std::memmove(
-        &inst->m_newData[0], &inst->m_newData[endIndex], size - endIndex);
-    inst->m_newData.resize(size - endIndex);
-
-    std::unique_lock<std::mutex> writeGuard(mutex);
-    instructions.emplace_back(
-        std::make_unique<Insert_Instruction>(std::move(instBefore)));
-    instructions.emplace_back(
-        std::make_unique<Repeat_Instruction>(std::move(instRepeat)));
-}
-
-/** Replace repeating segments in insertion instructions with repeats. */
-void insertions_to_repeats(
-    std::vector<std::unique_ptr<Differential_Instruction>>& baseInstructions) {
-    // Analyze segments larger than 36 bytes in a separate thread
-    Threader threader;
-    std::mutex instructionMutex;
-    std::vector<std::unique_ptr<Differential_Instruction>> newInstructions;
-    for (const auto& inst : get_large_insertions(baseInstructions)) {
-        threader.addJob([inst, &newInstructions, &instructionMutex]() {
-            size_t startIndex(0ULL);
-            size_t max(inst->m_newData.size());
-            while (startIndex + 36ULL < max) {
-                // Find how far this value is repeated for
-                const auto& value_at_x = inst->m_newData[startIndex];
-                const auto endIndex =
-                    startIndex +
-                    find_last_in_series(
-                        value_at_x,
-                        MemoryRange{ max - startIndex,
-                                     &inst->m_newData[startIndex] });
-
-                // Quit early if repeats less than 36 bytes
-                if ((endIndex - startIndex) <= 36ULL) {
-                    startIndex = endIndex;
-                    continue;
-                }
+    // Index every instruction, against a source range without any data
+    const auto dataSize = diffMemory.size() - diffHeaderSize;
+    auto instructions =
+        Buffer::decompress(diffMemory.subrange(diffHeaderSize, dataSize));
+    if (!instructions.has_value())
+        return {}; // Failure
+    Patch_Reader reader(std::move(*instructions));
+    auto patchIndex = index_instructions(
+        reader, legacy, header.m_targetSize,
+        { MemoryRange(sourceSize, nullptr) });
+    if (!patchIndex.has_value())
+        return {}; // Failure
 
-                // Split the insertion instruction into two, plus a repeat
-                split_insertion(
-                    inst, startIndex, endIndex, value_at_x, newInstructions,
-                    instructionMutex);
+    // In-place diffs write out of order, so sort them, ensuring no overlaps
+    auto& records = patchIndex->m_records;
+    if (!patchIndex->m_ordered) {
+        std::sort(
+            records.begin(), records.end(),
+            [](const auto& a, const auto& b) noexcept {
+                return a.m_index < b.m_index;
+            });
+        for (size_t x = 1ULL; x < records.size(); ++x)
+            if (records[x].m_index <
+                records[x - 1ULL].m_index + records[x - 1ULL].m_length)
+                return {}; // Failure
+    }
+    return Indexed_Diff{ header.m_targetSize, std::move(reader),
+                         std::move(records) };
+}
 
-                // Start at beginning of remaining segment
-                startIndex = 0ULL;
-                max = inst->m_newData.size();
-            }
+/** Compose a copy or addition of a second diff, reading the target of a
+first diff, from the instructions of the first diff which wrote what it
+reads. Ranges the first diff never wrote are zero, and the differences of
+additions are added onto whatever the first diff wrote. */
+void compose_record(
+    const Patch_Record& record, const std::byte* const secondBytes,
+    const Indexed_Diff& firstDiff, Instruction_Writer& writer,
+    std::vector<std::byte>& scratch) {
+    const auto& firstRecords = firstDiff.m_records;
+    const auto firstBytes = firstDiff.m_reader.expanded().bytes();
+    const auto isAddition = record.m_type == 'A';
+    const auto deltas = secondBytes + record.m_data;
+
+    // Find the first instruction ending after the read begins
+    auto piece = std::upper_bound(
+        firstRecords.cbegin(), firstRecords.cend(), record.m_beginRead,
+        [](const size_t& position, const Patch_Record& firstRecord) noexcept {
+            return position < firstRecord.m_index + firstRecord.m_length;
         });
+    for (size_t offset = 0ULL; offset < record.m_length;) {
+        const auto index = record.m_index + offset;
+        const auto position = record.m_beginRead + offset;
+        const auto remaining = record.m_length - offset;
+
+        // Gaps are zero, so copies leave them be, and additions insert
+        if (piece == firstRecords.cend() || piece->m_index > position) {
+            const auto length =
+                piece == firstRecords.cend()
+                    ? remaining
+                    : std::min(remaining, piece->m_index - position);
+            if (isAddition)
+                writer.write(
+                    Instruction_Record{ 'I', 0ULL, index, length },
+                    &deltas[offset]);
+            offset += length;
+            continue;
+        }
+
+        // Rewrite the portion of the instruction read
+        const auto pieceOffset = position - piece->m_index;
+        const auto length = std::min(remaining, piece->m_length - pieceOffset);
+        const auto data = firstBytes + piece->m_data;
+        const auto& period = piece->m_period;
+        if (piece->m_type == 'C' || piece->m_type == 'A') {
+            // Reads of the source remain reads of it, summing differences
+            const auto beginRead = piece->m_beginRead + pieceOffset;
+            const auto sourceAddition = piece->m_type == 'A';
+            auto differences = sourceAddition ? &data[pieceOffset]
+                                              : &deltas[offset];
+            if (sourceAddition && isAddition) {
+                scratch.resize(length);
+                add_differences(
+                    scratch.data(), differences, &deltas[offset], length);
+                differences = scratch.data();
+            }
+            writer.write(
+                Instruction_Record{ sourceAddition || isAddition ? 'A' : 'C',
+                                    0ULL, index, length, beginRead },
+                differences);
+        } else if (!isAddition && piece->m_type == 'I')
+            writer.write(
+                Instruction_Record{ 'I', 0ULL, index, length },
+                &data[pieceOffset]);
+        else if (!isAddition && piece->m_type == 'R')
+            writer.write(
+                Instruction_Record{ 'R', 1ULL, index, length }, data);
+        else if (!isAddition && period != 0ULL) {
+            // Patterns resume from the phase read, empty ones stay zero
+            const auto rotatedPeriod = std::min(period, length);
+            scratch.resize(rotatedPeriod);
+            for (size_t x = 0ULL; x < rotatedPeriod; ++x)
+                scratch[x] = data[(pieceOffset + x) % period];
+            writer.write(
+                Instruction_Record{ 'P', rotatedPeriod, index, length },
+                scratch.data());
+        } else if (isAddition) {
+            // Anything else added to becomes an insertion of the sums
+            scratch.resize(length);
+            for (size_t x = 0ULL; x < length; ++x)
+                scratch[x] = piece->m_type == 'I' ? data[pieceOffset + x]
+                             : piece->m_type == 'R' ? *data
+                             : period != 0ULL
+                                 ? data[(pieceOffset + x) % period]
+                                 : std::byte{ 0 };
+            add_differences(
+                scratch.data(), &deltas[offset], scratch.data(), length);
+            writer.write(
+                Instruction_Record{ 'I', 0ULL, index, length },
+                scratch.data());
+        }
+        offset += length;
+        if (pieceOffset + length == piece->m_length)
+            ++piece;
     }
+}
 
-    // Wait for jobs to finish
-    while (!threader.isFinished())
-        continue;
-    threader.shutdown();
+/** Everything a diff index keeps of its source. */
+struct Buffer::DiffIndex::Index_Data {
+    /** Index a source range, sorting its suffixes if the options need it,
+    or else chaining its windows and blocks. */
+    Index_Data(const MemoryRange& sourceMemory, const DiffOptions& options)
+        : m_source(sourceMemory) {
+        if (use_suffix_array(sourceMemory, options)) {
+            if (sourceMemory.size() < static_cast<size_t>(INT32_MAX))
+                m_smallSuffixes = sort_suffixes<int32_t>(sourceMemory);
+            else
+                m_largeSuffixes = sort_suffixes<int64_t>(sourceMemory);
+            return;
+        }
+        if (options.m_memoryBudget == 0ULL ||
+            Window_Chains::byte_size(sourceMemory, options.m_windowSize) <=
+                options.m_memoryBudget)
+            m_chains.emplace(sourceMemory, options.m_windowSize);
+        m_blocks.emplace(
+            sourceMemory, options.m_memoryBudget / sizeof(size_t));
+    }
 
-    // Join instruction sets together
-    baseInstructions.reserve(baseInstructions.size() + newInstructions.size());
-    baseInstructions.insert(
-        baseInstructions.end(),
-        std::make_move_iterator(newInstructions.begin()),
-        std::make_move_iterator(newInstructions.end()));
-}
+    /** The indexed source. */
+    MemoryRange m_source;
+    /** Every position of the source, chained by window, if they fit. */
+    std::optional<Window_Chains> m_chains;
+    /** Every aligned block of the source, keyed by its rolling hash. */
+    std::optional<Rolling_Hash_Index> m_blocks;
+    /** The sorted suffixes of the source, using whichever index size fits. */
+    std::vector<int32_t> m_smallSuffixes;
+    std::vector<int64_t> m_largeSuffixes;
+};
 
 // Public (de)Constructors
 
@@ -628,49 +2683,167 @@ void Buffer::pop_raw(void* const dataPtr, const size_t& size) {
 
 // Public Derivation Methods
 
-std::optional<Buffer> Buffer::compress() const {
-    return Buffer::compress(*this);
+std::optional<Buffer> Buffer::compress(const size_t& codecTag) const {
+    return Buffer::compress(*this, codecTag);
 }
 
-std::optional<Buffer> Buffer::compress(const Buffer& buffer) {
+std::optional<Buffer>
+Buffer::compress(const Buffer& buffer, const size_t& codecTag) {
     const MemoryRange& range = buffer;
-    return Buffer::compress(range);
+    return Buffer::compress(range, codecTag);
+}
+
+std::optional<Buffer>
+Buffer::compress(const MemoryRange& memoryRange, const size_t& codecTag) {
+    // Create a buffer large enough for the worst case
+    const auto destinationSize = compressBound(memoryRange.size(), codecTag);
+    if (memoryRange.empty() || destinationSize == 0ULL)
+        return {}; // Failure
+    Buffer compressedBuffer;
+    compressedBuffer.reserve(destinationSize);
+    compressedBuffer.resize(destinationSize);
+
+    // Try to compress the memory range
+    const auto compressedSize =
+        Buffer::compress(memoryRange, compressedBuffer, codecTag);
+    if (!compressedSize.has_value())
+        return {}; // Failure
+
+    // We now know the actual compressed size, no need to reallocate
+    compressedBuffer.resize(*compressedSize);
+
+    // Success
+    return compressedBuffer;
+}
+
+std::optional<size_t> Buffer::compress(
+    const MemoryRange& source, MemoryRange& destination,
+    const size_t& codecTag) {
+    return Buffer::compress(source, destination, MemoryRange(), codecTag);
 }
 
-std::optional<Buffer> Buffer::compress(const MemoryRange& memoryRange) {
+std::optional<size_t> Buffer::compress(
+    const MemoryRange& source, MemoryRange& destination,
+    const MemoryRange& dictionary, const size_t& codecTag) {
     // Ensure this buffer has some data to compress
-    if (memoryRange.empty())
+    if (source.empty() || destination.empty())
         return {}; // Failure
 
-    // Create a larger buffer twice the size, plus a unique header
-    const auto sourceSize = memoryRange.size();
-    const auto destinationSize = sourceSize * 2ULL;
+    // Ensure the requested codec exists
+    auto codec = Codec::Find(codecTag);
+    if (codec == nullptr)
+        return {}; // Failure
+
+    // Ensure the destination fits the header
     constexpr auto headerSize = sizeof(CompressionHeader);
-    Buffer compressedBuffer(headerSize + destinationSize);
-    CompressionHeader compressionHeader{ "yatta compress", sourceSize };
+    const auto sourceSize = source.size();
+    const auto destinationSize = destination.size();
+    if (destinationSize <= headerSize)
+        return {}; // Failure
+    auto payload =
+        destination.subrange(headerSize, destinationSize - headerSize);
+
+    // A flat byte histogram can still hide repeats, so when data looks
+    // incompressible, only store it if a block of it doesn't shrink either,
+    // using the payload as scratch space. Any other codec is always attempted
+    const auto storeCodec = Codec::Find(Codec::STORE);
+    if (codecTag == Codec::LZ4 && sourceSize >= EntropyProbeSize &&
+        source.entropy() >= IncompressibleEntropy) {
+        const auto probeSize = std::min(sourceSize, CompressionProbeSize);
+        const auto probe =
+            source.subrange((sourceSize - probeSize) / 2ULL, probeSize);
+        const auto probeCompressedSize = codec->compress(probe, payload);
+        if (!probeCompressedSize.has_value() ||
+            *probeCompressedSize >= probeSize)
+            codec = storeCodec;
+    }
 
-    // Copy header data into new buffer at the beginning
-    compressedBuffer.in_type(compressionHeader);
+    // Ensure the destination fits the worst case
+    if (destinationSize < compressBound(sourceSize, codec->tag()))
+        return {}; // Failure
+
+    // Try to compress the source range, offset by header's amount
+    auto compressedSize =
+        dictionary.empty()
+            ? codec->compress(source, payload)
+            : codec->compressWithDictionary(source, payload, dictionary);
+
+    // Store the data instead if compression didn't pay off
+    if (codec != storeCodec &&
+        (!compressedSize.has_value() || *compressedSize >= sourceSize)) {
+        codec = storeCodec;
+        compressedSize = codec->compress(source, payload);
+    }
 
-    // Try to compress the source buffer
-    const auto compressedSize = LZ4_compress_default(
-        memoryRange.charArray(),
-        &compressedBuffer.charArray()[headerSize], // Offset by header's amount
-        static_cast<int>(sourceSize), static_cast<int>(destinationSize));
+    // Ensure we have a non-zero sized result
+    if (!compressedSize.has_value() || *compressedSize == 0ULL)
+        return {}; // Failure
+
+    // Copy header data into the destination at the beginning
+    const CompressionHeader compressionHeader{ "yatta codec", sourceSize,
+                                               codec->tag() };
+    destination.in_type(compressionHeader);
+
+    // Success
+    return headerSize + *compressedSize;
+}
 
-    // Ensure we have a non-zero sized buffer
-    if (compressedSize == 0ULL)
+std::optional<Buffer> Buffer::compress_seekable(
+    const MemoryRange& memoryRange, const size_t& blockSize,
+    const size_t& codecTag) {
+    // Ensure we have data to compress, and a valid codec to use
+    const auto blockBound = compressBound(blockSize, codecTag);
+    if (memoryRange.empty() || blockSize == 0ULL || blockBound == 0ULL)
         return {}; // Failure
 
-    // We now know the actual compressed size, downsize our oversized buffer to
-    // the compressed size
-    compressedBuffer.resize(headerSize + compressedSize);
-    compressedBuffer.shrink();
+    // Create a buffer large enough for every block's worst case
+    const auto uncompressedSize = memoryRange.size();
+    const auto blockCount = ((uncompressedSize - 1ULL) / blockSize) + 1ULL;
+    const auto dataIndex =
+        sizeof(SeekableHeader) + (sizeof(size_t) * (blockCount + 1ULL));
+    Buffer compressedBuffer;
+    compressedBuffer.reserve(dataIndex + (blockBound * blockCount));
+    compressedBuffer.resize(dataIndex + (blockBound * blockCount));
+
+    // Compress each block independently, recording where it ends
+    size_t byteIndex = dataIndex;
+    compressedBuffer.in_type(byteIndex, sizeof(SeekableHeader));
+    for (size_t blockIndex = 0ULL; blockIndex < blockCount; ++blockIndex) {
+        const auto blockOffset = blockIndex * blockSize;
+        const auto block = memoryRange.subrange(
+            blockOffset, std::min(blockSize, uncompressedSize - blockOffset));
+        auto destination = compressedBuffer.subrange(byteIndex, blockBound);
+        const auto compressedSize =
+            Buffer::compress(block, destination, codecTag);
+        if (!compressedSize.has_value())
+            return {}; // Failure
+        byteIndex += *compressedSize;
+        compressedBuffer.in_type(
+            byteIndex,
+            sizeof(SeekableHeader) + (sizeof(size_t) * (blockIndex + 1ULL)));
+    }
+
+    // Copy header data into the buffer at the beginning
+    const SeekableHeader seekableHeader{ "yatta seekable", uncompressedSize,
+                                         blockSize, blockCount };
+    compressedBuffer.in_type(seekableHeader);
+
+    // We now know the actual compressed size, no need to reallocate
+    compressedBuffer.resize(byteIndex);
 
     // Success
     return compressedBuffer;
 }
 
+size_t Buffer::compressBound(const size_t& sourceSize, const size_t& codecTag) {
+    // Storing is always a valid fallback, so leave room for it too
+    const auto codec = Codec::Find(codecTag);
+    if (codec == nullptr)
+        return 0ULL;
+    return sizeof(CompressionHeader) +
+           std::max(codec->bound(sourceSize), sourceSize);
+}
+
 std::optional<Buffer> Buffer::decompress() const {
     return Buffer::decompress(*this);
 }
@@ -682,89 +2855,310 @@ std::optional<Buffer> Buffer::decompress(const Buffer& buffer) {
 
 std::optional<Buffer> Buffer::decompress(const MemoryRange& memoryRange) {
     // Ensure this buffer has some data to decompress
-    constexpr auto headerSize = sizeof(CompressionHeader);
-    if (memoryRange.size() < headerSize)
+    const auto uncompressedSize = decompressedSize(memoryRange);
+    if (!uncompressedSize.has_value())
+        return {}; // Failure
+
+    // Uncompress the remaining data
+    Buffer uncompressedBuffer;
+    uncompressedBuffer.reserve(*uncompressedSize);
+    uncompressedBuffer.resize(*uncompressedSize);
+    if (!Buffer::decompress(memoryRange, uncompressedBuffer))
         return {}; // Failure
 
+    // Success
+    return uncompressedBuffer;
+}
+
+std::optional<size_t>
+Buffer::decompress(const MemoryRange& source, MemoryRange& destination) {
+    return Buffer::decompress(source, destination, MemoryRange());
+}
+
+std::optional<size_t> Buffer::decompress(
+    const MemoryRange& source, MemoryRange& destination,
+    const MemoryRange& dictionary) {
+    // Seekable ranges are expanded block by block, without a dictionary
+    if (const auto seekableHeader = read_seekable_header(source)) {
+        const auto uncompressedSize = seekableHeader->m_uncompressedSize;
+        if (destination.size() < uncompressedSize)
+            return {}; // Failure
+        auto payload = destination.subrange(0ULL, uncompressedSize);
+        if (!Buffer::decompress_range(source, 0ULL, payload))
+            return {}; // Failure
+        return uncompressedSize;
+    }
+
     // Read in header
-    CompressionHeader header;
-    memoryRange.out_type(header);
+    const auto header = read_compression_header(source);
+    if (!header.has_value())
+        return {}; // Failure
+    const auto& [compressionHeader, headerSize] = *header;
 
-    // Ensure header title matches
-    if (std::strcmp(header.m_title, "yatta compress") != 0)
+    // Ensure the destination is large enough
+    const auto uncompressedSize = compressionHeader.m_uncompressedSize;
+    if (destination.size() < uncompressedSize)
+        return {}; // Failure
+
+    // Find the codec this range was compressed with
+    const auto codec = Codec::Find(compressionHeader.m_codecTag);
+    if (codec == nullptr)
         return {}; // Failure
 
     // Uncompress the remaining data
-    Buffer uncompressedBuffer(header.m_uncompressedSize);
-    const auto decompressionResult = LZ4_decompress_safe(
-        &memoryRange.charArray()[headerSize], uncompressedBuffer.charArray(),
-        static_cast<int>(memoryRange.size() - headerSize),
-        static_cast<int>(uncompressedBuffer.size()));
+    auto payload = destination.subrange(0ULL, uncompressedSize);
+    const auto compressedRange =
+        source.subrange(headerSize, source.size() - headerSize);
+    if (!(dictionary.empty() ? codec->decompress(compressedRange, payload)
+                             : codec->decompressWithDictionary(
+                                   compressedRange, payload, dictionary)))
+        return {}; // Failure
+
+    // Success
+    return uncompressedSize;
+}
 
-    // Ensure we have a non-zero sized decompressed buffer
-    if (decompressionResult <= 0)
+std::optional<Buffer> Buffer::decompress_range(
+    const MemoryRange& memoryRange, const size_t& offset,
+    const size_t& length) {
+    // Create a buffer for just the requested portion
+    if (length == 0ULL)
+        return {}; // Failure
+    Buffer uncompressedBuffer;
+    uncompressedBuffer.reserve(length);
+    uncompressedBuffer.resize(length);
+    if (!Buffer::decompress_range(memoryRange, offset, uncompressedBuffer))
         return {}; // Failure
 
     // Success
     return uncompressedBuffer;
 }
 
-std::optional<Buffer> Buffer::diff(const Buffer& target) const {
-    return Buffer::diff(*this, target);
+bool Buffer::decompress_range(
+    const MemoryRange& source, const size_t& offset,
+    MemoryRange& destination) {
+    // Ensure the requested portion lies within the uncompressed data
+    const auto uncompressedSize = decompressedSize(source);
+    const auto length = destination.size();
+    if (!uncompressedSize.has_value() || length == 0ULL ||
+        offset > *uncompressedSize || length > *uncompressedSize - offset)
+        return false; // Failure
+
+    // Non-seekable ranges must be expanded in full
+    const auto header = read_seekable_header(source);
+    if (!header.has_value()) {
+        const auto uncompressedBuffer = Buffer::decompress(source);
+        if (!uncompressedBuffer.has_value())
+            return false; // Failure
+        const auto portion = uncompressedBuffer->subrange(offset, length);
+        std::copy(portion.cbegin(), portion.cend(), destination.begin());
+        return true; // Success
+    }
+
+    // Expand only the blocks overlapping the requested portion
+    const auto blockSize = header->m_blockSize;
+    const auto firstBlock = offset / blockSize;
+    const auto lastBlock = (offset + length - 1ULL) / blockSize;
+    thread_local Buffer partialBlock;
+    for (auto blockIndex = firstBlock; blockIndex <= lastBlock; ++blockIndex) {
+        const auto block = read_seekable_block(source, *header, blockIndex);
+        if (!block.has_value())
+            return false; // Failure
+
+        // Find the overlap between this block and the requested portion
+        const auto blockOffset = blockIndex * blockSize;
+        const auto blockLength =
+            std::min(blockSize, *uncompressedSize - blockOffset);
+        const auto overlapBegin = std::max(offset, blockOffset);
+        const auto overlapEnd =
+            std::min(offset + length, blockOffset + blockLength);
+        auto overlap = destination.subrange(
+            overlapBegin - offset, overlapEnd - overlapBegin);
+
+        // Whole blocks expand directly, partial blocks use a scratch buffer
+        if (overlap.size() == blockLength) {
+            if (Buffer::decompress(*block, overlap) != blockLength)
+                return false; // Failure
+            continue;
+        }
+        if (partialBlock.size() < blockLength) {
+            partialBlock.reserve(blockLength);
+            partialBlock.resize(blockLength);
+        }
+        auto blockRange = partialBlock.subrange(0ULL, blockLength);
+        if (Buffer::decompress(*block, blockRange) != blockLength)
+            return false; // Failure
+        const auto portion = blockRange.subrange(
+            overlapBegin - blockOffset, overlapEnd - overlapBegin);
+        std::copy(portion.cbegin(), portion.cend(), overlap.begin());
+    }
+
+    // Success
+    return true;
+}
+
+std::optional<size_t>
+Buffer::decompressedSize(const MemoryRange& memoryRange) {
+    if (const auto header = read_seekable_header(memoryRange))
+        return header->m_uncompressedSize;
+    if (const auto header = read_compression_header(memoryRange))
+        return header->first.m_uncompressedSize;
+    return {}; // Failure
+}
+
+Buffer::DiffOptions::DiffOptions() noexcept = default;
+
+Buffer::DiffOptions::DiffOptions(const DiffMode& mode) noexcept
+    : DiffOptions(
+          mode == DiffMode::HIGH_RATIO ? MaxRatio() : Balanced()) {}
+
+Buffer::DiffOptions Buffer::DiffOptions::Fast() noexcept {
+    DiffOptions options;
+    options.m_minMatch = 64ULL;
+    options.m_searchDepth = 4ULL;
+    return options;
+}
+
+Buffer::DiffOptions Buffer::DiffOptions::Balanced() noexcept {
+    return DiffOptions();
+}
+
+Buffer::DiffOptions Buffer::DiffOptions::MaxRatio() noexcept {
+    DiffOptions options;
+    options.m_mode = DiffMode::HIGH_RATIO;
+    return options;
+}
+
+Buffer::DiffIndex::DiffIndex(
+    const MemoryRange& sourceMemory, const DiffOptions& options)
+    : m_data(std::make_shared<const Index_Data>(sourceMemory, options)) {}
+
+const MemoryRange& Buffer::DiffIndex::source() const noexcept {
+    return m_data->m_source;
+}
+
+bool Buffer::DiffIndex::hasSuffixArray() const noexcept {
+    return !m_data->m_smallSuffixes.empty() ||
+           !m_data->m_largeSuffixes.empty();
 }
 
 std::optional<Buffer>
-Buffer::diff(const Buffer& sourceBuffer, const Buffer& targetBuffer) {
+Buffer::diff(const Buffer& target, const DiffOptions& options) const {
+    return Buffer::diff(*this, target, options);
+}
+
+std::optional<Buffer> Buffer::diff(
+    const Buffer& sourceBuffer, const Buffer& targetBuffer,
+    const DiffOptions& options) {
     const MemoryRange& sourcetRange = sourceBuffer;
     const MemoryRange& targetRange = targetBuffer;
-    return Buffer::diff(sourcetRange, targetRange);
+    return Buffer::diff(sourcetRange, targetRange, options);
 }
 
-std::optional<Buffer>
-Buffer::diff(const MemoryRange& sourceMemory, const MemoryRange& targetMemory) {
+std::optional<Buffer> Buffer::diff(
+    const MemoryRange& sourceMemory, const MemoryRange& targetMemory,
+    const DiffOptions& options) {
     // Ensure that at least ONE of the two source buffers exists
     if (sourceMemory.empty() && targetMemory.empty())
         return {}; // Failure
 
-    // Convert matching regions into diff instructions
-    auto instructions = generate_instructions(sourceMemory, targetMemory);
-
-    // Replace insertions with some repeat instructions
-    insertions_to_repeats(instructions);
+    auto instructions = diff_instructions(sourceMemory, targetMemory, options);
+    return write_diff(instructions, targetMemory, options);
+}
 
-    // Create a buffer to contain all the diff instructions
-    const auto size_patch = std::accumulate(
-        instructions.cbegin(), instructions.cend(), 0ULL,
-        [](const auto& currentSum, const auto& instruction) noexcept {
-            return currentSum + instruction->size();
-        });
-    Buffer patchBuffer(size_patch);
+std::optional<Buffer> Buffer::diff(
+    const std::vector<MemoryRange>& baseMemories,
+    const MemoryRange& targetMemory, const DiffOptions& options) {
+    // Ensure there's a base to read from, in-place patches overwrite just one
+    if (baseMemories.empty() || options.m_inPlace)
+        return {}; // Failure
 
-    // Write the instruction data to a buffer
-    for (const auto& instruction : instructions)
-        instruction->write(patchBuffer);
+    // Ensure at least one base or the target exists
+    std::vector<size_t> baseSizes;
+    baseSizes.reserve(baseMemories.size());
+    for (const auto& baseMemory : baseMemories)
+        baseSizes.push_back(baseMemory.size());
+    const auto basesSize =
+        std::accumulate(baseSizes.cbegin(), baseSizes.cend(), 0ULL);
+    if (basesSize == 0ULL && targetMemory.empty())
+        return {}; // Failure
 
-    // Free up memory
-    instructions.clear();
-    instructions.shrink_to_fit();
+    // Diff each base alone, if the patch must apply from any one of them
+    if (options.m_independentBases)
+        return write_independent_diff(
+            baseMemories, targetMemory, options, baseSizes);
+
+    // Otherwise match against every base at once, as if they were one source
+    Buffer combinedBases;
+    combinedBases.reserve(basesSize);
+    for (const auto& baseMemory : baseMemories)
+        if (!baseMemory.empty())
+            combinedBases.push_raw(baseMemory.bytes(), baseMemory.size());
+
+    auto instructions =
+        diff_instructions(combinedBases, targetMemory, options);
+    combinedBases.clear(); // Free up memory
+    split_across_bases(instructions, baseSizes);
+    return write_diff(instructions, targetMemory, options, baseSizes);
+}
 
-    // Try to compress the patch buffer
-    if (auto result = patchBuffer.compress())
-        std::swap(patchBuffer, *result);
-    else
+std::optional<Buffer> Buffer::diff(
+    const DiffIndex& sourceIndex, const MemoryRange& targetMemory,
+    const DiffOptions& options) {
+    // Ensure that at least ONE of the two source buffers exists
+    const auto& index = *sourceIndex.m_data;
+    const auto& sourceMemory = index.m_source;
+    if (sourceMemory.empty() && targetMemory.empty())
         return {}; // Failure
 
-    // Prepend header information
-    constexpr size_t headerSize = sizeof(DifferentialHeader);
-    DifferentialHeader diffHeader{ "yatta diff", targetMemory.size() };
-    Buffer bufferWithHeader;
-    bufferWithHeader.reserve(patchBuffer.size() + headerSize);
-
-    // Copy header data into new buffer at the beginning
-    bufferWithHeader.push_type(diffHeader);
-    bufferWithHeader.push_raw(patchBuffer.bytes(), patchBuffer.size());
+    // Match the target's middle against every suffix of the whole source
+    const auto trimmed = trim_ranges(sourceMemory, targetMemory);
+    const auto& targetMiddle = trimmed.m_targetMiddle;
+    Instruction_Set instructions;
+    if (options.m_mode == DiffMode::HIGH_RATIO &&
+        sourceIndex.hasSuffixArray()) {
+        if (!index.m_smallSuffixes.empty())
+            instructions = generate_suffix_instructions(
+                index.m_smallSuffixes, sourceMemory, targetMiddle,
+                options.m_minRepeat);
+        else
+            instructions = generate_suffix_instructions(
+                index.m_largeSuffixes, sourceMemory, targetMiddle,
+                options.m_minRepeat);
+        untrim_instructions(
+            instructions, trimmed, sourceMemory, targetMemory, false);
+        return write_diff(instructions, targetMemory, options);
+    }
 
-    return bufferWithHeader; // Success
+    // Otherwise match aligned windows of the target's middle against the
+    // source's chains, then search the whole source for anything left inserted
+    if (index.m_chains) {
+        if (!targetMiddle.empty()) {
+            instructions = generate_indexed_instructions(
+                *index.m_chains, sourceMemory, targetMiddle, trimmed.m_prefix,
+                options);
+            coalesce_instructions(instructions, targetMiddle);
+        }
+        untrim_instructions(
+            instructions, trimmed, sourceMemory, targetMemory, false);
+    } else {
+        // Chain the middles anew for each target if the index couldn't
+        if (!targetMiddle.empty()) {
+            instructions = generate_instructions(
+                trimmed.m_sourceMiddle, targetMiddle, options);
+            coalesce_instructions(instructions, targetMiddle);
+        }
+        untrim_instructions(
+            instructions, trimmed, sourceMemory, targetMemory, true);
+    }
+    if (index.m_blocks)
+        insertions_to_copies(
+            instructions, *index.m_blocks, sourceMemory, targetMemory,
+            options);
+    else
+        insertions_to_copies(
+            instructions, sourceMemory, targetMemory, options);
+    return write_diff(instructions, targetMemory, options);
 }
 
 std::optional<Buffer> Buffer::patch(const Buffer& diffBuffer) const {
@@ -780,52 +3174,209 @@ Buffer::patch(const Buffer& sourceBuffer, const Buffer& diffBuffer) {
 
 std::optional<Buffer>
 Buffer::patch(const MemoryRange& sourceMemory, const MemoryRange& diffMemory) {
-    // Ensure diff buffer at least *exists*, empty source = new file
-    if (diffMemory.empty())
+    // Ensure diff buffer at least holds a header, empty source = new file
+    constexpr size_t diffHeaderSize = sizeof(DifferentialHeader);
+    if (diffMemory.size() < diffHeaderSize)
         return {}; // Failure
 
     // Read in header
     DifferentialHeader header;
     diffMemory.out_type(header);
 
-    // Ensure header title matches
-    if (std::strcmp(header.m_title, "yatta diff") != 0)
+    // Ensure header title matches, older diffs use fixed-width fields
+    const auto legacy = std::strcmp(header.m_title, "yatta diff") == 0;
+    if (!legacy && std::strcmp(header.m_title, "yatta diff v2") != 0 &&
+        std::strcmp(header.m_title, "yatta diff ip") != 0)
         return {}; // Failure
 
-    // Try to decompress the diff buffer
+    // Patch the target from the source alone
+    return apply_patch(
+        { sourceMemory },
+        diffMemory.subrange(diffHeaderSize, diffMemory.size() - diffHeaderSize),
+        header.m_targetSize, legacy);
+}
+
+std::optional<Buffer> Buffer::patch(
+    const std::vector<MemoryRange>& baseMemories,
+    const MemoryRange& diffMemory) {
+    // Ensure diff buffer at least holds a header and its number of bases
     constexpr size_t diffHeaderSize = sizeof(DifferentialHeader);
-    const auto dataSize = diffMemory.size() - diffHeaderSize;
-    auto patchBuffer =
-        decompress(diffMemory.subrange(diffHeaderSize, dataSize));
-    if (!patchBuffer.has_value())
+    if (diffMemory.size() < diffHeaderSize + sizeof(size_t))
+        return {}; // Failure
+
+    // Read in header, ensuring the diff was made against several bases
+    DifferentialHeader header;
+    diffMemory.out_type(header);
+    const auto independent = std::strcmp(header.m_title, "yatta diff mi") == 0;
+    if (!independent && std::strcmp(header.m_title, "yatta diff mb") != 0)
+        return {}; // Failure
+
+    // Ensure every base is supplied in order, each the size it was diffed
+    // with, unless it's missing and left empty
+    size_t baseCount(0ULL);
+    diffMemory.out_type(baseCount, diffHeaderSize);
+    const auto tableSize = diffMemory.size() - diffHeaderSize - sizeof(size_t);
+    if (baseCount != baseMemories.size() ||
+        baseCount > tableSize / sizeof(size_t))
         return {}; // Failure
-    const auto patchBufferSize = patchBuffer->size();
+    for (size_t x = 0ULL; x < baseCount; ++x) {
+        size_t baseSize(0ULL);
+        diffMemory.out_type(
+            baseSize, diffHeaderSize + ((x + 1ULL) * sizeof(size_t)));
+        if (!baseMemories[x].empty() && baseMemories[x].size() != baseSize)
+            return {}; // Failure
+    }
+
+    // Split out each independent base's whole diff, ensuring they span the
+    // rest of the stream
+    const auto instructionOffset =
+        diffHeaderSize + ((baseCount + 1ULL) * sizeof(size_t));
+    if (independent) {
+        std::vector<MemoryRange> baseDiffs;
+        baseDiffs.reserve(baseCount);
+        size_t offset(instructionOffset);
+        for (size_t x = 0ULL; x < baseCount; ++x) {
+            size_t diffSize(0ULL);
+            if (diffMemory.size() - offset < sizeof(size_t))
+                return {}; // Failure
+            diffMemory.out_type(diffSize, offset);
+            offset += sizeof(size_t);
+            if (diffSize > diffMemory.size() - offset)
+                return {}; // Failure
+            baseDiffs.emplace_back(diffMemory.subrange(offset, diffSize));
+            offset += diffSize;
+        }
+        if (offset != diffMemory.size())
+            return {}; // Failure
+
+        // Patch from the first base present, or else from the first base
+        // diffed while empty, as its diff only inserts
+        auto chosen = baseCount;
+        for (size_t x = 0ULL; x < baseCount; ++x) {
+            if (!baseMemories[x].empty()) {
+                chosen = x;
+                break;
+            }
+        }
+        for (size_t x = 0ULL; x < baseCount && chosen == baseCount; ++x) {
+            size_t baseSize(0ULL);
+            diffMemory.out_type(
+                baseSize, diffHeaderSize + ((x + 1ULL) * sizeof(size_t)));
+            if (baseSize == 0ULL)
+                chosen = x;
+        }
+        if (chosen == baseCount)
+            return {}; // Failure
+        auto result = Buffer::patch(baseMemories[chosen], baseDiffs[chosen]);
+        if (!result || result->size() != header.m_targetSize)
+            return {}; // Failure
+        return result;
+    }
 
-    // Convert buffer into instructions
-    Buffer bufferNew(header.m_targetSize);
-    size_t byteIndex(0ULL);
-    while (byteIndex < patchBufferSize) {
-        // Deduce the instruction type
-        char type(0);
-        patchBuffer->out_type(type, byteIndex);
-        byteIndex += sizeof(char);
+    // Patch the target, failing if it reads from any missing base
+    return apply_patch(
+        baseMemories,
+        diffMemory.subrange(
+            instructionOffset, diffMemory.size() - instructionOffset),
+        header.m_targetSize, false);
+}
 
-        // Make and execute the instruction from the diff buffer memory
-        const auto executeInstruction = [&](auto instruction) {
-            // Read the instruction
-            instruction.read(*patchBuffer, byteIndex);
+bool Buffer::patch_stream(
+    const MemoryRange& sourceMemory, const MemoryRange& diffMemory,
+    const PatchSink& sink) {
+    // Ensure the diff holds at least a header, and there's a sink to write to
+    constexpr size_t diffHeaderSize = sizeof(DifferentialHeader);
+    if (diffMemory.size() < diffHeaderSize || !sink)
+        return false; // Failure
 
-            // Execute the instruction
-            instruction.execute(bufferNew, sourceMemory);
-        };
-        if (type == 'R')
-            executeInstruction(Repeat_Instruction());
-        else if (type == 'I')
-            executeInstruction(Insert_Instruction());
-        else if (type == 'C')
-            executeInstruction(Copy_Instruction());
+    // Read in header
+    DifferentialHeader header;
+    diffMemory.out_type(header);
+
+    // Older diffs may be out of target order, so patch them whole instead
+    if (std::strcmp(header.m_title, "yatta diff") == 0) {
+        const auto target = Buffer::patch(sourceMemory, diffMemory);
+        return target.has_value() && (target->empty() || sink(*target));
     }
+    if (std::strcmp(header.m_title, "yatta diff v2") != 0)
+        return false; // Failure
+
+    // Stream every instruction to the sink in target order
+    Patch_Reader reader(diffMemory.subrange(
+        diffHeaderSize, diffMemory.size() - diffHeaderSize));
+    Patch_Writer writer(header.m_targetSize, sink);
+    Differential_Cursor cursor;
+    char type(0);
+    while (reader.read_type(type))
+        if (!stream_instruction(type, reader, writer, cursor, sourceMemory))
+            return false; // Failure
+
+    // Ensure every block was expanded, then write the remaining target
+    return !reader.failed() && writer.finish();
+}
 
-    // Success
-    return bufferNew;
+bool Buffer::patch_in_place(const MemoryRange& diffMemory) {
+    // Ensure the diff holds at least a header
+    constexpr size_t diffHeaderSize = sizeof(DifferentialHeader);
+    if (diffMemory.size() < diffHeaderSize)
+        return false; // Failure
+
+    // Read in header, ensuring the diff was ordered for in-place patching
+    DifferentialHeader header;
+    diffMemory.out_type(header);
+    if (std::strcmp(header.m_title, "yatta diff ip") != 0)
+        return false; // Failure
+
+    // Grow to fit the target first, as copies only read the source
+    const auto sourceSize = size();
+    if (header.m_targetSize > sourceSize) {
+        reserve(header.m_targetSize);
+        resize(header.m_targetSize);
+    }
+
+    // Apply every instruction over this buffer, in the order written
+    Patch_Reader reader(diffMemory.subrange(
+        diffHeaderSize, diffMemory.size() - diffHeaderSize));
+    Differential_Cursor cursor;
+    char type(0);
+    while (reader.read_type(type))
+        if (!apply_in_place(type, reader, *this, cursor, sourceSize))
+            return false; // Failure
+    if (reader.failed())
+        return false; // Failure
+
+    // Drop any source past the end of the target
+    resize(header.m_targetSize);
+    return true; // Success
+}
+
+std::optional<Buffer> Buffer::compose(
+    const MemoryRange& firstDiff, const MemoryRange& secondDiff) {
+    // Index both diffs, the second reading from the first's target
+    const auto first = index_diff(firstDiff, SIZE_MAX);
+    if (!first.has_value())
+        return {}; // Failure
+    const auto second = index_diff(secondDiff, first->m_targetSize);
+    if (!second.has_value())
+        return {}; // Failure
+
+    // Rewrite every read of the intermediate target as instructions of the
+    // first diff, keeping anything else the second diff writes
+    const auto secondBytes = second->m_reader.expanded().bytes();
+    Instruction_Writer writer;
+    std::vector<std::byte> scratch;
+    for (const auto& record : second->m_records) {
+        if (record.m_type == 'C' || record.m_type == 'A')
+            compose_record(record, secondBytes, *first, writer, scratch);
+        else
+            writer.write(
+                Instruction_Record{ record.m_type, record.m_period,
+                                    record.m_index, record.m_length },
+                secondBytes + record.m_data);
+    }
+
+    // Package the instructions as a diff from the first diff's source
+    return package_diff(
+        writer.finish(),
+        DifferentialHeader{ "yatta diff v2", second->m_targetSize }, {});
 }
\ No newline at end of file
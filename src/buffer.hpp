@@ -2,10 +2,13 @@
 #ifndef YATTA_BUFFER_H
 #define YATTA_BUFFER_H
 
+#include "codec.hpp"
 #include "memoryRange.hpp"
+#include <functional>
 #include <memory>
 #include <optional>
 #include <type_traits>
+#include <vector>
 
 namespace yatta {
 /** An expandable contiguous memory range, similar to a std::vector<std::byte>.
@@ -14,6 +17,109 @@ Inherits all memory range functions, and provides pushing, popping,
 compressing, expanding, diffing, and patching operations. */
 class Buffer : public MemoryRange {
     public:
+    // Public Enumerations
+    /** Strategies for finding matches when diffing. */
+    enum class DiffMode {
+        /** Match aligned windows, then index the source with a rolling hash.
+        Fast and parallel, using memory proportional to the inputs. */
+        FAST,
+        /** Match approximately against a suffix array of the source, storing
+        byte-wise differences, for much smaller patches at a slower speed.
+        The suffix array takes 4 bytes per source byte, or 8 bytes for sources
+        of 2GB or more, on top of the source and target themselves. */
+        HIGH_RATIO
+    };
+
+    // Public Structures
+    /** Tuning for generating diffs, with presets for common trade-offs. */
+    struct DiffOptions {
+        /** Construct the balanced options. */
+        DiffOptions() noexcept;
+        /** Construct the default options for a diff strategy, balanced for
+        fast diffs and max-ratio for high-ratio diffs. Implicit, so a strategy
+        may be passed wherever options are expected.
+        @param  mode            the strategy to find matches with. */
+        DiffOptions(const DiffMode& mode) noexcept;
+
+        // Public Static Methods
+        /** Retrieve options favouring speed over patch size.
+        @return                 the fast options. */
+        [[nodiscard]] static DiffOptions Fast() noexcept;
+        /** Retrieve options balancing speed and patch size.
+        @return                 the balanced options. */
+        [[nodiscard]] static DiffOptions Balanced() noexcept;
+        /** Retrieve options favouring patch size over speed.
+        @return                 the max-ratio options. */
+        [[nodiscard]] static DiffOptions MaxRatio() noexcept;
+
+        // Public Attributes
+        /** The strategy to find matches with. */
+        DiffMode m_mode = DiffMode::FAST;
+        /** The byte size of the aligned windows matched in parallel, for
+        fast diffs. */
+        size_t m_windowSize = 16384ULL;
+        /** The fewest matching bytes worth copying, for fast diffs. */
+        size_t m_minMatch = 32ULL;
+        /** The most candidates compared per position, for fast diffs. */
+        size_t m_searchDepth = 16ULL;
+        /** The fewest bytes a repeating value must span to become a repeat. */
+        size_t m_minRepeat = 36ULL;
+        /** The most threads to use, or 0 for one per hardware thread. */
+        size_t m_threadCount = 0ULL;
+        /** The most bytes to spend indexing the source, or 0 for no limit.
+        High-ratio diffs fall back to fast diffs when their suffix array
+        won't fit, fast diffs index fewer source blocks, and diff indexes
+        only chain their windows if they fit. */
+        size_t m_memoryBudget = 0ULL;
+        /** Whether to order instructions so the patch may overwrite its
+        source with patch_in_place(), instead of being streamed. */
+        bool m_inPlace = false;
+        /** Whether diffs against several bases diff each base alone, so the
+        patch applies from any one base present, instead of copying from
+        them together. */
+        bool m_independentBases = false;
+    };
+
+    // Public Classes
+    /** A source range indexed once, so it may be diffed against many targets
+    without being indexed again. Diffs may share an index across threads, and
+    copies of an index share it too. The source range must outlive it. */
+    class DiffIndex {
+        public:
+        // Public (de)Constructors
+        /** Index a source range for the strategy and memory budget supplied.
+        High-ratio options sort its suffixes, if they fit the budget, while
+        other options chain its windows and blocks instead.
+        @param  sourceMemory    the range to diff from.
+        @param  options         the strategy and memory budget to index for.
+        */
+        explicit DiffIndex(
+            const MemoryRange& sourceMemory,
+            const DiffOptions& options = DiffOptions());
+
+        // Public Methods
+        /** Retrieve the indexed source range.
+        @return                 the range diffs against this index are from. */
+        [[nodiscard]] const MemoryRange& source() const noexcept;
+        /** Check if the source's suffixes were sorted, so diffs against this
+        index may use high-ratio matching.
+        @return                 true if sorted, false otherwise. */
+        [[nodiscard]] bool hasSuffixArray() const noexcept;
+
+        private:
+        // Private Structures
+        struct Index_Data;
+
+        // Private Attributes
+        friend class Buffer;
+        std::shared_ptr<const Index_Data> m_data;
+    };
+
+    // Public Type Definitions
+    /** Receives consecutive portions of a patched target, in order. Portions
+    are only valid during the call. Returns false to stop patching. */
+    using PatchSink = std::function<bool(const MemoryRange&)>;
+
     // Public (de)Constructors
     /** Destroy the buffer, freeing any allocated memory. */
     ~Buffer() = default;
@@ -112,20 +218,81 @@ class Buffer : public MemoryRange {
 
     // Public Derivation Methods
     /** Compresses the contents of this buffer into a new buffer.
+    Data sampled as incompressible skips the default LZ4 codec and is stored
+    instead, unless a block of it still shrinks. Any other codec is always
+    attempted.
+    @param  codecTag        the tag of the codec to compress with.
     @return                 the compressed buffer on success, empty otherwise.
     */
-    [[nodiscard]] std::optional<Buffer> compress() const;
+    [[nodiscard]] std::optional<Buffer>
+    compress(const size_t& codecTag = Codec::LZ4) const;
     /** Compresses the contents of the supplied buffer into a new buffer.
+    Data sampled as incompressible skips the default LZ4 codec and is stored
+    instead, unless a block of it still shrinks. Any other codec is always
+    attempted.
     @param  buffer          the buffer to compress.
+    @param  codecTag        the tag of the codec to compress with.
     @return                 the compressed buffer on success, empty otherwise.
     */
-    [[nodiscard]] static std::optional<Buffer> compress(const Buffer& buffer);
+    [[nodiscard]] static std::optional<Buffer>
+    compress(const Buffer& buffer, const size_t& codecTag = Codec::LZ4);
     /** Compresses the supplied memory range into a new buffer.
+    Data sampled as incompressible skips the default LZ4 codec and is stored
+    instead, unless a block of it still shrinks. Any other codec is always
+    attempted.
     @param  memoryRange     the memory range to compress.
+    @param  codecTag        the tag of the codec to compress with.
     @return                 the compressed buffer on success, empty otherwise.
     */
-    [[nodiscard]] static std::optional<Buffer>
-    compress(const MemoryRange& memoryRange);
+    [[nodiscard]] static std::optional<Buffer> compress(
+        const MemoryRange& memoryRange, const size_t& codecTag = Codec::LZ4);
+    /** Compresses the supplied memory range into a caller-provided range,
+    without allocating any memory.
+    Data sampled as incompressible skips the default LZ4 codec and is stored
+    instead, unless a block of it still shrinks. Any other codec is always
+    attempted.
+    @param  source          the memory range to compress.
+    @param  destination     the memory range to write into, at least
+    compressBound() bytes long.
+    @param  codecTag        the tag of the codec to compress with.
+    @return                 the number of bytes written on success, empty
+    otherwise. */
+    [[nodiscard]] static std::optional<size_t> compress(
+        const MemoryRange& source, MemoryRange& destination,
+        const size_t& codecTag = Codec::LZ4);
+    /** Compresses the supplied memory range into a caller-provided range,
+    referencing a shared dictionary, without allocating any memory.
+    Data sampled as incompressible skips the default LZ4 codec and is stored
+    instead, unless a block of it still shrinks. Any other codec is always
+    attempted.
+    @param  source          the memory range to compress.
+    @param  destination     the memory range to write into, at least
+    compressBound() bytes long.
+    @param  dictionary      the dictionary to reference, required again for
+    decompression.
+    @param  codecTag        the tag of the codec to compress with.
+    @return                 the number of bytes written on success, empty
+    otherwise. */
+    [[nodiscard]] static std::optional<size_t> compress(
+        const MemoryRange& source, MemoryRange& destination,
+        const MemoryRange& dictionary, const size_t& codecTag);
+    /** Compresses the supplied memory range into a new seekable buffer, made
+    of independently compressed blocks, allowing for partial decompression.
+    @param  memoryRange     the memory range to compress.
+    @param  blockSize       the number of uncompressed bytes per block.
+    @param  codecTag        the tag of the codec to compress with.
+    @return                 the compressed buffer on success, empty otherwise.
+    */
+    [[nodiscard]] static std::optional<Buffer> compress_seekable(
+        const MemoryRange& memoryRange, const size_t& blockSize = 65536ULL,
+        const size_t& codecTag = Codec::LZ4);
+    /** Retrieve the largest number of bytes compressing a range may produce.
+    @param  sourceSize      the number of bytes to be compressed.
+    @param  codecTag        the tag of the codec to compress with.
+    @return                 the worst-case compressed size, including its
+    header, or zero if the codec isn't registered. */
+    [[nodiscard]] static size_t compressBound(
+        const size_t& sourceSize, const size_t& codecTag = Codec::LZ4);
     /** Decompress the contents of this buffer into a new buffer.
     @return                 the decompressed buffer on success, empty otherwise.
     */
@@ -141,25 +308,108 @@ class Buffer : public MemoryRange {
     */
     [[nodiscard]] static std::optional<Buffer>
     decompress(const MemoryRange& memoryRange);
+    /** Decompress the supplied memory range into a caller-provided range,
+    without allocating any memory.
+    @param  source          the memory range to decompress.
+    @param  destination     the memory range to write into, at least
+    decompressedSize() bytes long.
+    @return                 the number of bytes written on success, empty
+    otherwise. */
+    [[nodiscard]] static std::optional<size_t>
+    decompress(const MemoryRange& source, MemoryRange& destination);
+    /** Decompress the supplied memory range into a caller-provided range,
+    referencing the dictionary it was compressed with, without allocating any
+    memory.
+    @param  source          the memory range to decompress.
+    @param  destination     the memory range to write into, at least
+    decompressedSize() bytes long.
+    @param  dictionary      the dictionary the range was compressed with.
+    @return                 the number of bytes written on success, empty
+    otherwise. */
+    [[nodiscard]] static std::optional<size_t> decompress(
+        const MemoryRange& source, MemoryRange& destination,
+        const MemoryRange& dictionary);
+    /** Decompress a portion of the supplied memory range into a new buffer.
+    Seekable ranges only expand the blocks covering the requested portion.
+    @param  memoryRange     the memory range to decompress.
+    @param  offset          the uncompressed byte offset to begin at.
+    @param  length          the number of uncompressed bytes to retrieve.
+    @return                 the decompressed portion on success, empty
+    otherwise. */
+    [[nodiscard]] static std::optional<Buffer> decompress_range(
+        const MemoryRange& memoryRange, const size_t& offset,
+        const size_t& length);
+    /** Decompress a portion of the supplied memory range into a
+    caller-provided range, filling it entirely. Seekable ranges only expand the
+    blocks covering the requested portion.
+    @param  source          the memory range to decompress.
+    @param  offset          the uncompressed byte offset to begin at.
+    @param  destination     the memory range to write into.
+    @return                 true on success, false otherwise. */
+    [[nodiscard]] static bool decompress_range(
+        const MemoryRange& source, const size_t& offset,
+        MemoryRange& destination);
+    /** Retrieve the uncompressed size of a compressed memory range.
+    @param  memoryRange     the compressed memory range.
+    @return                 the number of bytes decompression will produce on
+    success, empty otherwise. */
+    [[nodiscard]] static std::optional<size_t>
+    decompressedSize(const MemoryRange& memoryRange);
     /** Diff this buffer against the supplied buffer, generating a patch
     instruction set.
     @param  target          the buffer to diff against.
+    @param  options         the strategy and tuning to find matches with.
     @return                 the diff buffer on success, empty otherwise. */
-    [[nodiscard]] std::optional<Buffer> diff(const Buffer& target) const;
+    [[nodiscard]] std::optional<Buffer> diff(
+        const Buffer& target,
+        const DiffOptions& options = DiffOptions()) const;
     /** Diff the supplied buffers against each other, generating a patch
     instruction set.
     @param  sourceBuffer    the buffer to diff from.
     @param  targetBuffer    the buffer to diff against.
+    @param  options         the strategy and tuning to find matches with.
     @return                 the diff buffer on success, empty otherwise. */
-    [[nodiscard]] static std::optional<Buffer>
-    diff(const Buffer& sourceBuffer, const Buffer& targetBuffer);
+    [[nodiscard]] static std::optional<Buffer> diff(
+        const Buffer& sourceBuffer, const Buffer& targetBuffer,
+        const DiffOptions& options = DiffOptions());
     /** Diff the supplied memory ranges against each other, generating a patch
     instruction set.
     @param  sourceMemory    the range to diff from.
     @param  targetMemory    the range to diff against.
+    @param  options         the strategy and tuning to find matches with.
     @return                 the diff buffer on success, empty otherwise. */
-    [[nodiscard]] static std::optional<Buffer>
-    diff(const MemoryRange& sourceMemory, const MemoryRange& targetMemory);
+    [[nodiscard]] static std::optional<Buffer> diff(
+        const MemoryRange& sourceMemory, const MemoryRange& targetMemory,
+        const DiffOptions& options = DiffOptions());
+    /** Diff an indexed source against the supplied memory range, generating
+    a patch instruction set. Only the target is matched anew, so diffing one
+    source against many targets indexes it just once. Copies may come from
+    anywhere in the source, so patches may differ from unindexed diffs.
+    @param  sourceIndex     the index of the range to diff from.
+    @param  targetMemory    the range to diff against.
+    @param  options         the strategy and tuning to find matches with,
+    where high-ratio matching needs an index with a suffix array, and the
+    window size is the one the index was chained with.
+    @return                 the diff buffer on success, empty otherwise. */
+    [[nodiscard]] static std::optional<Buffer> diff(
+        const DiffIndex& sourceIndex, const MemoryRange& targetMemory,
+        const DiffOptions& options = DiffOptions());
+    /** Diff several base memory ranges against a target, generating a patch
+    instruction set which may copy from any of them, such as every older
+    version a target may be upgraded from. The bases are matched as if laid
+    end to end, so they're copied together while diffing, and the patch needs
+    every base it copies from. Independent bases are diffed one at a time
+    instead, each inserting whatever it lacks, so the patch needs just one.
+    @param  baseMemories    the ranges to diff from, in the order the patch
+    expects them.
+    @param  targetMemory    the range to diff against.
+    @param  options         the strategy and tuning to find matches with,
+    which can't be in-place.
+    @return                 the diff buffer on success, empty otherwise. */
+    [[nodiscard]] static std::optional<Buffer> diff(
+        const std::vector<MemoryRange>& baseMemories,
+        const MemoryRange& targetMemory,
+        const DiffOptions& options = DiffOptions());
     /** Patch the contents of this buffer into a new buffer, using the supplied
     diff buffer.
     @param  diffBuffer      the patch instruction set to use.
@@ -179,6 +429,46 @@ class Buffer : public MemoryRange {
     @return                 the patched buffer on success, empty otherwise. */
     [[nodiscard]] static std::optional<Buffer>
     patch(const MemoryRange& sourceMemory, const MemoryRange& diffMemory);
+    /** Patch a new buffer from several base memory ranges, using a diff
+    generated against them all. Bases which aren't present may be left empty,
+    so long as the diff never reads from them. Diffs of independent bases
+    patch from the first base present, or any base diffed while empty.
+    @param  baseMemories    the ranges to patch from, in the order diffed.
+    @param  diffMemory      the multi-base patch instruction set to use.
+    @return                 the patched buffer on success, empty otherwise. */
+    [[nodiscard]] static std::optional<Buffer> patch(
+        const std::vector<MemoryRange>& baseMemories,
+        const MemoryRange& diffMemory);
+    /** Patch the contents of the supplied memory range, streaming the target
+    to a sink in order rather than holding it in memory. Large diffs are
+    expanded a block at a time, so memory use stays bounded. Older diffs may
+    write their target out of order, so they're patched whole by patch()
+    instead, and the target passed to the sink at once.
+    @param  sourceMemory    the source memory range to patch from.
+    @param  diffMemory      the patch instruction set to use.
+    @param  sink            the sink to write the target to.
+    @return                 true on success, false otherwise. */
+    [[nodiscard]] static bool patch_stream(
+        const MemoryRange& sourceMemory, const MemoryRange& diffMemory,
+        const PatchSink& sink);
+    /** Patch the contents of this buffer in place, overwriting it with the
+    target. Only needs the larger of the source and target in memory, and
+    keeps its capacity, so reserving the target's size up front avoids
+    reallocating. Requires a diff made with DiffOptions::m_inPlace.
+    @param  diffMemory      the in-place patch instruction set to use.
+    @return                 true on success, false otherwise, which may leave
+    this buffer partially patched. */
+    [[nodiscard]] bool patch_in_place(const MemoryRange& diffMemory);
+    /** Compose 2 diffs applied one after another into a single diff, such
+    as merging a diff from A to B with a diff from B to C into a diff from A
+    to C. Instructions are rewritten in terms of one another without ever
+    patching B, so only the diffs are held in memory. Multi-base diffs can't
+    be composed.
+    @param  firstDiff       the diff from the original source.
+    @param  secondDiff      the diff from the first diff's target.
+    @return                 the composed diff on success, empty otherwise. */
+    [[nodiscard]] static std::optional<Buffer>
+    compose(const MemoryRange& firstDiff, const MemoryRange& secondDiff);
 
     protected:
     // Protected Attributes
@@ -0,0 +1,203 @@
+#include "codec.hpp"
+#include "lz4/lz4.h"
+#include "lz4/lz4hc.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+
+// Convenience Definitions
+using yatta::Codec;
+using yatta::MemoryRange;
+
+/** Codec which copies data verbatim, for data that won't compress. */
+struct Store_Codec final : public Codec {
+    // Interface Implementation
+    [[nodiscard]] size_t tag() const noexcept final { return Codec::STORE; }
+    [[nodiscard]] size_t bound(const size_t& sourceSize) const noexcept final {
+        return sourceSize;
+    }
+    [[nodiscard]] std::optional<size_t>
+    compress(const MemoryRange& source, MemoryRange& destination) const final {
+        if (source.size() > destination.size())
+            return {}; // Failure
+        std::memcpy(destination.bytes(), source.bytes(), source.size());
+        return source.size();
+    }
+    [[nodiscard]] bool decompress(
+        const MemoryRange& source, MemoryRange& destination) const final {
+        if (source.size() != destination.size())
+            return false; // Failure
+        std::memcpy(destination.bytes(), source.bytes(), source.size());
+        return true;
+    }
+};
+/** Codec using the default LZ4 block compressor. */
+struct LZ4_Codec : public Codec {
+    // Interface Implementation
+    [[nodiscard]] size_t tag() const noexcept override { return Codec::LZ4; }
+    [[nodiscard]] size_t bound(const size_t& sourceSize) const noexcept final {
+        if (sourceSize > static_cast<size_t>(LZ4_MAX_INPUT_SIZE))
+            return 0ULL;
+        return static_cast<size_t>(
+            LZ4_compressBound(static_cast<int>(sourceSize)));
+    }
+    [[nodiscard]] std::optional<size_t> compress(
+        const MemoryRange& source, MemoryRange& destination) const override {
+        if (source.size() > static_cast<size_t>(LZ4_MAX_INPUT_SIZE))
+            return {}; // Failure
+        const auto compressedSize = LZ4_compress_default(
+            source.charArray(), destination.charArray(),
+            static_cast<int>(source.size()),
+            static_cast<int>(std::min<size_t>(
+                destination.size(), static_cast<size_t>(INT_MAX))));
+        if (compressedSize <= 0)
+            return {}; // Failure
+        return static_cast<size_t>(compressedSize);
+    }
+    [[nodiscard]] bool decompress(
+        const MemoryRange& source, MemoryRange& destination) const final {
+        if (source.size() > static_cast<size_t>(INT_MAX) ||
+            destination.size() > static_cast<size_t>(INT_MAX))
+            return false; // Failure
+        const auto decompressedSize = LZ4_decompress_safe(
+            source.charArray(), destination.charArray(),
+            static_cast<int>(source.size()),
+            static_cast<int>(destination.size()));
+        return decompressedSize >= 0 &&
+               static_cast<size_t>(decompressedSize) == destination.size();
+    }
+    [[nodiscard]] std::optional<size_t> compressWithDictionary(
+        const MemoryRange& source, MemoryRange& destination,
+        const MemoryRange& dictionary) const final {
+        if (source.size() > static_cast<size_t>(LZ4_MAX_INPUT_SIZE) ||
+            dictionary.size() > static_cast<size_t>(INT_MAX))
+            return {}; // Failure
+
+        // Loading a dictionary is costly, so keep the last one loaded per
+        // thread, and copy its state into a fresh stream for each call
+        // Matches are verified against the dictionary's current bytes, so a
+        // stale entry at a reused address only costs ratio, never correctness
+        thread_local LZ4_stream_t dictionaryStream;
+        thread_local LZ4_stream_t workingStream;
+        thread_local std::pair<const std::byte*, size_t> loadedDictionary{
+            nullptr, 0ULL
+        };
+        const std::pair<const std::byte*, size_t> dictionaryKey{
+            dictionary.bytes(), dictionary.size()
+        };
+        if (loadedDictionary != dictionaryKey) {
+            LZ4_initStream(&dictionaryStream, sizeof(LZ4_stream_t));
+            LZ4_loadDict(
+                &dictionaryStream, dictionary.charArray(),
+                static_cast<int>(dictionary.size()));
+            loadedDictionary = dictionaryKey;
+        }
+        std::memcpy(&workingStream, &dictionaryStream, sizeof(LZ4_stream_t));
+
+        const auto compressedSize = LZ4_compress_fast_continue(
+            &workingStream, source.charArray(), destination.charArray(),
+            static_cast<int>(source.size()),
+            static_cast<int>(std::min<size_t>(
+                destination.size(), static_cast<size_t>(INT_MAX))),
+            1);
+        if (compressedSize <= 0)
+            return {}; // Failure
+        return static_cast<size_t>(compressedSize);
+    }
+    [[nodiscard]] bool decompressWithDictionary(
+        const MemoryRange& source, MemoryRange& destination,
+        const MemoryRange& dictionary) const final {
+        if (source.size() > static_cast<size_t>(INT_MAX) ||
+            destination.size() > static_cast<size_t>(INT_MAX) ||
+            dictionary.size() > static_cast<size_t>(INT_MAX))
+            return false; // Failure
+        const auto decompressedSize = LZ4_decompress_safe_usingDict(
+            source.charArray(), destination.charArray(),
+            static_cast<int>(source.size()),
+            static_cast<int>(destination.size()), dictionary.charArray(),
+            static_cast<int>(dictionary.size()));
+        return decompressedSize >= 0 &&
+               static_cast<size_t>(decompressedSize) == destination.size();
+    }
+};
+/** Codec emitting standard LZ4 blocks, using the reference LZ4 HC compressor.
+Trades compression speed for ratio, decompressing just as fast as LZ4.
+Dictionary compression falls back to the default LZ4 compressor. */
+struct LZ4HC_Codec final : public LZ4_Codec {
+    // Interface Implementation
+    [[nodiscard]] size_t tag() const noexcept final { return Codec::LZ4HC; }
+    [[nodiscard]] std::optional<size_t>
+    compress(const MemoryRange& source, MemoryRange& destination) const final {
+        if (source.size() > static_cast<size_t>(LZ4_MAX_INPUT_SIZE))
+            return {}; // Failure
+
+        // The HC state is large, so keep one per thread rather than
+        // allocating it every call
+        thread_local LZ4_streamHC_t state;
+        const auto compressedSize = LZ4_compress_HC_extStateHC(
+            &state, source.charArray(), destination.charArray(),
+            static_cast<int>(source.size()),
+            static_cast<int>(std::min<size_t>(
+                destination.size(), static_cast<size_t>(INT_MAX))),
+            LZ4HC_CLEVEL_DEFAULT);
+        if (compressedSize <= 0)
+            return {}; // Failure
+        return static_cast<size_t>(compressedSize);
+    }
+};
+
+/** Thread-safe container of all registered codecs. */
+struct Codec_Registry {
+    std::shared_mutex m_mutex;
+    std::map<size_t, std::shared_ptr<const Codec>> m_codecs;
+};
+
+// Private Static Methods
+
+/** Retrieve the codec registry, populated with the built-in codecs. */
+Codec_Registry& get_registry() {
+    static Codec_Registry registry{
+        {},
+        { { Codec::STORE, std::make_shared<Store_Codec>() },
+          { Codec::LZ4, std::make_shared<LZ4_Codec>() },
+          { Codec::LZ4HC, std::make_shared<LZ4HC_Codec>() } }
+    };
+    return registry;
+}
+
+// Public Interface
+
+std::optional<size_t> Codec::compressWithDictionary(
+    const MemoryRange& source, MemoryRange& destination,
+    const MemoryRange& /*unused*/) const {
+    return compress(source, destination);
+}
+
+bool Codec::decompressWithDictionary(
+    const MemoryRange& source, MemoryRange& destination,
+    const MemoryRange& /*unused*/) const {
+    return decompress(source, destination);
+}
+
+// Public Static Methods
+
+void Codec::Register(const std::shared_ptr<const Codec>& codec) {
+    if (codec == nullptr)
+        return;
+    auto& registry = get_registry();
+    std::unique_lock<std::shared_mutex> writeGuard(registry.m_mutex);
+    registry.m_codecs[codec->tag()] = codec;
+}
+
+std::shared_ptr<const Codec> Codec::Find(const size_t& tag) {
+    auto& registry = get_registry();
+    std::shared_lock<std::shared_mutex> readGuard(registry.m_mutex);
+    if (const auto codec = registry.m_codecs.find(tag);
+        codec != registry.m_codecs.end())
+        return codec->second;
+    return nullptr;
+}
\ No newline at end of file
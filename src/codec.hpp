@@ -0,0 +1,104 @@
+#pragma once
+#ifndef YATTA_CODEC_H
+#define YATTA_CODEC_H
+
+#include "memoryRange.hpp"
+#include <memory>
+#include <optional>
+
+namespace yatta {
+/** Interface for a block compression algorithm.
+Each codec is identified by a unique tag, which is stored in the header of any
+buffer it compresses, allowing decompression to dispatch to the right codec.
+Built-in codecs are registered automatically, and embedders may register their
+own codecs for domain-specific data. */
+class Codec {
+    public:
+    // Public Enumerations
+    /** Tags for the built-in codecs, user codecs should use tags >= USER. */
+    enum Tag : size_t {
+        STORE = 0ULL,
+        LZ4 = 1ULL,
+        LZ4HC = 2ULL,
+        USER = 256ULL,
+    };
+
+    // Public (de)Constructors
+    /** Destroy this codec. */
+    virtual ~Codec() = default;
+    /** Construct a codec. */
+    Codec() = default;
+    /** Construct a codec, copying from another.
+    @param  other           the codec to copy from. */
+    Codec(const Codec& other) = default;
+    /** Construct a codec, moving from another.
+    @param  other           the codec to move from. */
+    Codec(Codec&& other) noexcept = default;
+
+    // Public Assignment Operators
+    /** Copy-assignment operator.
+    @param  other           the codec to copy from.
+    @return                 reference to this. */
+    Codec& operator=(const Codec& other) = default;
+    /** Move-assignment operator.
+    @param  other           the codec to move from.
+    @return                 reference to this. */
+    Codec& operator=(Codec&& other) noexcept = default;
+
+    // Public Interface
+    /** Retrieve the unique tag identifying this codec.
+    @return                 this codec's tag. */
+    [[nodiscard]] virtual size_t tag() const noexcept = 0;
+    /** Retrieve the worst-case compressed size for a given input size.
+    @param  sourceSize      the number of bytes to be compressed.
+    @return                 the largest number of bytes compression may emit. */
+    [[nodiscard]] virtual size_t
+    bound(const size_t& sourceSize) const noexcept = 0;
+    /** Compress the source range into the destination range.
+    @param  source          the memory range to compress.
+    @param  destination     the memory range to write into.
+    @return                 the number of bytes written on success, empty
+    otherwise. */
+    [[nodiscard]] virtual std::optional<size_t>
+    compress(const MemoryRange& source, MemoryRange& destination) const = 0;
+    /** Decompress the source range into the destination range.
+    @param  source          the memory range to decompress.
+    @param  destination     the memory range to write into, sized exactly to
+    the uncompressed data.
+    @return                 true on success, false otherwise. */
+    [[nodiscard]] virtual bool
+    decompress(const MemoryRange& source, MemoryRange& destination) const = 0;
+
+    /** Compress the source range into the destination range, referencing a
+    shared dictionary. Codecs without dictionary support ignore it.
+    @param  source          the memory range to compress.
+    @param  destination     the memory range to write into.
+    @param  dictionary      the dictionary to reference.
+    @return                 the number of bytes written on success, empty
+    otherwise. */
+    [[nodiscard]] virtual std::optional<size_t> compressWithDictionary(
+        const MemoryRange& source, MemoryRange& destination,
+        const MemoryRange& dictionary) const;
+    /** Decompress the source range into the destination range, referencing
+    the same dictionary it was compressed with.
+    @param  source          the memory range to decompress.
+    @param  destination     the memory range to write into, sized exactly to
+    the uncompressed data.
+    @param  dictionary      the dictionary to reference.
+    @return                 true on success, false otherwise. */
+    [[nodiscard]] virtual bool decompressWithDictionary(
+        const MemoryRange& source, MemoryRange& destination,
+        const MemoryRange& dictionary) const;
+
+    // Public Static Methods
+    /** Register a codec, replacing any other codec using the same tag.
+    @param  codec           the codec to register. */
+    static void Register(const std::shared_ptr<const Codec>& codec);
+    /** Retrieve the registered codec matching a given tag.
+    @param  tag             the tag of the codec to find.
+    @return                 the matching codec on success, nullptr otherwise. */
+    [[nodiscard]] static std::shared_ptr<const Codec> Find(const size_t& tag);
+};
+}; // namespace yatta
+
+#endif // YATTA_CODEC_H
\ No newline at end of file
@@ -2,10 +2,13 @@
 #include <algorithm>
 #include <cassert>
 #include <fstream>
+#include <cstring>
 #include <numeric>
+#include <unordered_map>
 
 // Convenience definitions
 using yatta::Buffer;
+using yatta::MemoryRange;
 using yatta::Directory;
 using filepath = std::filesystem::path;
 using directory_itt = std::filesystem::directory_iterator;
@@ -17,7 +20,28 @@ struct FileInstruction {
     std::string path, fullPath;
     Buffer instructionBuffer;
     size_t diff_oldHash = 0ULL, diff_newHash = 0ULL;
+    char flag = 'U';
 }; /** Contains diff instructions for a specific file. */
+struct PackageEntry {
+    std::string path;
+    size_t size = 0ULL, offset = 0ULL, compressedSize = 0ULL;
+}; /** Locates a specific file within a package. */
+struct PackageTable {
+    Buffer dictionary;
+    std::vector<PackageEntry> entries;
+    size_t dataOffset = 0ULL;
+}; /** Contains the dictionary and file locations of a package. */
+
+/** The largest dictionary LZ4 can reference. */
+constexpr size_t MaxDictionarySize = 65536ULL;
+/** The number of bytes dictionaries are built from, across all files. */
+constexpr size_t DictionaryScanSize = 8388608ULL;
+/** The size of each segment of file data placed in a dictionary. */
+constexpr size_t DictionarySegmentSize = 256ULL;
+/** The size of the substrings dictionary segments are scored by. */
+constexpr size_t DictionaryKmerSize = sizeof(size_t);
+/** Files with a higher sampled entropy are left out of dictionaries. */
+constexpr double DictionaryEntropyLimit = 7.5;
 
 // Private Static Methods
 
@@ -94,6 +118,228 @@ void in_files(
     }
 }
 
+/** Build a compression dictionary from the segments of files whose content
+recurs most often across other files, similar to zstd's COVER algorithm. */
+Buffer build_dictionary(const FileList& files) {
+    // Only sample files which look compressible, capping how much is scanned
+    std::vector<MemoryRange> samples;
+    for (const auto& file : files)
+        if (file.m_data.size() >= DictionaryKmerSize &&
+            file.m_data.entropy() < DictionaryEntropyLimit)
+            samples.emplace_back(file.m_data);
+    Buffer dictionary;
+    if (samples.empty())
+        return dictionary;
+    const auto sampleLimit =
+        std::max(DictionaryScanSize / samples.size(), DictionarySegmentSize);
+    for (auto& sample : samples)
+        sample = sample.subrange(0ULL, std::min(sample.size(), sampleLimit));
+
+    // Assign each distinct k-mer an id, counting how many files contain it
+    struct KmerInfo {
+        size_t fileCount = 0ULL, lastFile = SIZE_MAX;
+        bool covered = false;
+    };
+    std::vector<KmerInfo> kmers;
+    std::unordered_map<size_t, size_t> kmerIds;
+    std::vector<size_t> positionIds;
+    std::vector<size_t> sampleOffsets;
+    for (size_t fileIndex = 0ULL; fileIndex < samples.size(); ++fileIndex) {
+        const auto& sample = samples[fileIndex];
+        const auto kmerCount = sample.size() - DictionaryKmerSize + 1ULL;
+        sampleOffsets.emplace_back(positionIds.size());
+        for (size_t index = 0ULL; index < kmerCount; ++index) {
+            size_t kmer(0ULL);
+            std::memcpy(&kmer, &sample.bytes()[index], DictionaryKmerSize);
+            const auto [kmerId, inserted] =
+                kmerIds.try_emplace(kmer, kmers.size());
+            if (inserted)
+                kmers.emplace_back();
+            auto& info = kmers[kmerId->second];
+            if (info.lastFile != fileIndex) {
+                info.lastFile = fileIndex;
+                ++info.fileCount;
+            }
+            positionIds.emplace_back(kmerId->second);
+        }
+    }
+
+    // Score segments by the k-mers they share with other files,
+    // ignoring k-mers already covered by previously chosen segments
+    struct Segment {
+        size_t score, idOffset, idCount;
+        MemoryRange range;
+    };
+    const auto score_segment = [&](const Segment& segment) {
+        size_t score(0ULL);
+        for (size_t index = 0ULL; index < segment.idCount; ++index)
+            if (const auto& info = kmers[positionIds[segment.idOffset + index]];
+                !info.covered && info.fileCount > 1ULL)
+                score += info.fileCount;
+        return score;
+    };
+    std::vector<Segment> segments;
+    for (size_t fileIndex = 0ULL; fileIndex < samples.size(); ++fileIndex) {
+        const auto& sample = samples[fileIndex];
+        for (size_t index = 0ULL; index + DictionaryKmerSize <= sample.size();
+             index += DictionarySegmentSize) {
+            const auto length =
+                std::min(DictionarySegmentSize, sample.size() - index);
+            Segment segment{ 0ULL, sampleOffsets[fileIndex] + index,
+                             length - DictionaryKmerSize + 1ULL,
+                             sample.subrange(index, length) };
+            segment.score = score_segment(segment);
+            if (segment.score > 0ULL)
+                segments.emplace_back(segment);
+        }
+    }
+
+    // Lazily pick the best scoring segment, re-scoring it before accepting
+    const auto compare = [](const Segment& a, const Segment& b) noexcept {
+        return a.score < b.score;
+    };
+    std::make_heap(segments.begin(), segments.end(), compare);
+    std::vector<MemoryRange> chosenSegments;
+    size_t dictionarySize(0ULL);
+    while (!segments.empty() && dictionarySize < MaxDictionarySize) {
+        std::pop_heap(segments.begin(), segments.end(), compare);
+        auto segment = segments.back();
+        segments.pop_back();
+        if (const auto newScore = score_segment(segment);
+            newScore < segment.score) {
+            segment.score = newScore;
+            if (newScore > 0ULL) {
+                segments.emplace_back(segment);
+                std::push_heap(segments.begin(), segments.end(), compare);
+            }
+            continue;
+        }
+
+        // Accept the segment, covering all of its k-mers
+        for (size_t index = 0ULL; index < segment.idCount; ++index)
+            kmers[positionIds[segment.idOffset + index]].covered = true;
+        const auto length =
+            std::min(segment.range.size(), MaxDictionarySize - dictionarySize);
+        chosenSegments.emplace_back(segment.range.subrange(0ULL, length));
+        dictionarySize += length;
+    }
+
+    // Place the best segments last, closest to the data being compressed
+    dictionary.reserve(dictionarySize);
+    for (auto segment = chosenSegments.crbegin();
+         segment != chosenSegments.crend(); ++segment)
+        dictionary.push_raw(segment->bytes(), segment->size());
+    return dictionary;
+}
+
+/** Parse the dictionary and file table of a dictionary-compressed package.
+Every offset and size is checked against the package before it is used. */
+std::optional<PackageTable>
+read_package_table(const Buffer& packageBuffer, size_t byteIndex) {
+    PackageTable table;
+    const auto packageSize = packageBuffer.size();
+    const auto fits = [&](const size_t& size) noexcept {
+        return byteIndex <= packageSize && size <= packageSize - byteIndex;
+    };
+
+    // Read and expand the dictionary, if present
+    size_t dictionarySize(0ULL);
+    if (!fits(sizeof(size_t)))
+        return {}; // Failure
+    packageBuffer.out_type(dictionarySize, byteIndex);
+    byteIndex += sizeof(size_t);
+    if (dictionarySize != 0ULL) {
+        if (!fits(dictionarySize))
+            return {}; // Failure
+        auto dictionary = Buffer::decompress(
+            packageBuffer.subrange(byteIndex, dictionarySize));
+        if (!dictionary.has_value())
+            return {}; // Failure
+        table.dictionary = std::move(*dictionary);
+        byteIndex += dictionarySize;
+    }
+
+    // Read the location of every file, each taking at least 5 sizes
+    size_t fileCount(0ULL);
+    if (!fits(sizeof(size_t)))
+        return {}; // Failure
+    packageBuffer.out_type(fileCount, byteIndex);
+    byteIndex += sizeof(size_t);
+    constexpr auto minimumEntrySize = sizeof(size_t) * 5ULL;
+    if (fileCount > (packageSize - byteIndex) / minimumEntrySize)
+        return {}; // Failure
+    table.entries.resize(fileCount);
+    for (auto& entry : table.entries) {
+        size_t pathSize(0ULL);
+        if (!fits(sizeof(size_t)))
+            return {}; // Failure
+        packageBuffer.out_type(pathSize, byteIndex);
+        if (pathSize > packageSize - byteIndex ||
+            !fits(minimumEntrySize + (sizeof(char) * pathSize)))
+            return {}; // Failure
+        packageBuffer.out_type(entry.path, byteIndex);
+        byteIndex += sizeof(size_t) + (sizeof(char) * entry.path.size()) +
+                     sizeof(size_t);
+        packageBuffer.out_type(entry.size, byteIndex);
+        byteIndex += sizeof(size_t);
+        packageBuffer.out_type(entry.offset, byteIndex);
+        byteIndex += sizeof(size_t);
+        packageBuffer.out_type(entry.compressedSize, byteIndex);
+        byteIndex += sizeof(size_t);
+    }
+    table.dataOffset = byteIndex;
+
+    // Ensure every file lies within the package
+    const auto dataSize = packageSize - byteIndex;
+    for (const auto& entry : table.entries)
+        if (entry.offset > dataSize ||
+            entry.compressedSize > dataSize - entry.offset)
+            return {}; // Failure
+
+    return table;
+}
+
+/** Expand a single file from a dictionary-compressed package. */
+std::optional<Buffer> read_package_entry(
+    const Buffer& packageBuffer, const PackageTable& table,
+    const PackageEntry& entry) {
+    Buffer fileBuffer;
+    if (entry.size == 0ULL)
+        return fileBuffer;
+
+    // Ensure the file lies within the package, and expands to its stated size
+    // before allocating for it
+    if (table.dataOffset > packageBuffer.size())
+        return {}; // Failure
+    const auto dataSize = packageBuffer.size() - table.dataOffset;
+    if (entry.offset > dataSize ||
+        entry.compressedSize > dataSize - entry.offset)
+        return {}; // Failure
+    const auto compressedRange = packageBuffer.subrange(
+        table.dataOffset + entry.offset, entry.compressedSize);
+    if (Buffer::decompressedSize(compressedRange) != entry.size)
+        return {}; // Failure
+
+    fileBuffer.reserve(entry.size);
+    fileBuffer.resize(entry.size);
+    if (Buffer::decompress(compressedRange, fileBuffer, table.dictionary) !=
+        entry.size)
+        return {}; // Failure
+    return fileBuffer;
+}
+
+/** Read the header of a package, and the index its contents begin at. */
+auto read_package_header(const Buffer& packageBuffer) {
+    char packHeaderTitle[16ULL] = { '\0' };
+    std::string packHeaderName;
+    size_t byteIndex = sizeof(packHeaderTitle);
+    packageBuffer.out_type(packHeaderTitle);
+    packageBuffer.out_type(packHeaderName, byteIndex);
+    byteIndex += sizeof(size_t) + (sizeof(char) * packHeaderName.size()) +
+                 sizeof(size_t);
+    return std::make_pair(std::string(packHeaderTitle), byteIndex);
+}
+
 /** Attempt to patch a file using an instruction. */
 void patch_file(
     Directory::VirtualFile& file, const FileInstruction& instruction) {
@@ -107,8 +353,11 @@ void patch_file(
 /** Attempt to create a new file using an instruction. */
 std::optional<Directory::VirtualFile>
 add_file(const FileInstruction& instruction) {
-    // Attempt to make a new file by patching an empty buffer
-    if (auto result = Buffer().patch(instruction.instructionBuffer);
+    // Attempt to make a new file by expanding its data, or by patching an
+    // empty buffer as older deltas did
+    if (auto result = instruction.flag == 'F'
+                          ? instruction.instructionBuffer.decompress()
+                          : Buffer().patch(instruction.instructionBuffer);
         result.has_value() && result->hash() == instruction.diff_newHash)
         // Emplace the file
         return Directory::VirtualFile{ instruction.path, std::move(*result) };
@@ -127,7 +376,7 @@ void in_instructions(
          files < expectedFileCount && byteIndex < instBufSize; ++files) {
         // Accumulate attributes here
         FileInstruction instruction;
-        char flag(0);
+        auto& flag = instruction.flag;
         size_t instructionSize(0ULL);
 
         // Read Attributes
@@ -158,7 +407,7 @@ void in_instructions(
         // Place the instruction in the correct container
         if (flag == 'U')
             diffInstructions.emplace_back(std::move(instruction));
-        else if (flag == 'N')
+        else if (flag == 'N' || flag == 'F')
             addInstructions.emplace_back(std::move(instruction));
         else if (flag == 'D')
             removeInstructions.emplace_back(std::move(instruction));
@@ -188,7 +437,9 @@ void out_instruction(
 }
 
 /** Generate diff instructions from a set of src and dst files. */
-auto gen_instructions(const FileList& srcFiles, const FileList& dstFiles) {
+auto gen_instructions(
+    const FileList& srcFiles, const FileList& dstFiles,
+    const Buffer::DiffOptions& options) {
     // Retrieve all common, added, and removed files
     auto [commonFiles, addedFiles, removedFiles] =
         get_file_lists(srcFiles, dstFiles);
@@ -198,7 +449,7 @@ auto gen_instructions(const FileList& srcFiles, const FileList& dstFiles) {
     size_t instCount(0ULL);
     for (const auto& [oldFile, newFile] : commonFiles) {
         // Check if a common file has changed
-        const auto diffBuffer = oldFile.m_data.diff(newFile.m_data);
+        const auto diffBuffer = oldFile.m_data.diff(newFile.m_data, options);
         const auto oldHash = oldFile.m_data.hash();
         const auto newHash = newFile.m_data.hash();
         if (diffBuffer.has_value() && oldHash != newHash) {
@@ -210,12 +461,12 @@ auto gen_instructions(const FileList& srcFiles, const FileList& dstFiles) {
     }
     commonFiles.clear();
 
-    // These files are brand new
+    // These files are brand new, with nothing to match against
     for (const auto& nFile : addedFiles) {
-        if (const auto diffBuffer = Buffer().diff(nFile.m_data)) {
+        if (const auto fileBuffer = nFile.m_data.compress()) {
             out_instruction(
-                nFile.m_relativePath, 0ULL, nFile.m_data.hash(), *diffBuffer,
-                'N', instructionBuffer);
+                nFile.m_relativePath, 0ULL, nFile.m_data.hash(), *fileBuffer,
+                'F', instructionBuffer);
             instCount++;
         }
     }
@@ -335,6 +586,37 @@ std::string Directory::GetRunningDirectory() noexcept {
     return std::string(cCurrentPath);
 }
 
+std::optional<Buffer> Directory::GetPackagedFile(
+    const Buffer& packageBuffer, const std::string& relativePath) {
+    // Ensure the package buffer exists
+    if (packageBuffer.empty())
+        return {}; // Failure
+
+    // Legacy packages must be expanded in full to find the file
+    const auto [packHeaderTitle, byteIndex] =
+        read_package_header(packageBuffer);
+    if (packHeaderTitle == "yatta pack") {
+        Directory directory(packageBuffer);
+        for (auto& file : directory.m_files)
+            if (file.m_relativePath == relativePath)
+                return std::move(file.m_data);
+        return {}; // Failure
+    }
+
+    // Ensure header title matches
+    if (packHeaderTitle != "yatta pack v2")
+        return {}; // Failure
+
+    // Expand only the requested file
+    const auto table = read_package_table(packageBuffer, byteIndex);
+    if (!table.has_value())
+        return {}; // Failure
+    for (const auto& entry : table->entries)
+        if (entry.path == relativePath)
+            return read_package_entry(packageBuffer, *table, entry);
+    return {}; // Failure
+}
+
 // Public Manipulation Methods
 
 void Directory::clear() noexcept { m_files.clear(); }
@@ -394,26 +676,43 @@ bool Directory::in_package(const Buffer& packageBuffer) {
         return false; // Failure
 
     // Read in header
-    char packHeaderTitle[16ULL] = { '\0' };
-    std::string packHeaderName;
-    size_t byteIndex = sizeof(packHeaderTitle);
-    packageBuffer.out_type(packHeaderTitle);
-    packageBuffer.out_type(packHeaderName, byteIndex);
-    byteIndex += sizeof(size_t) + (sizeof(char) * packHeaderName.size()) +
-                 sizeof(size_t);
+    const auto [packHeaderTitle, byteIndex] =
+        read_package_header(packageBuffer);
+
+    // Legacy packages compress all files together
+    if (packHeaderTitle == "yatta pack") {
+        // Try to decompress the archive buffer
+        auto filebuffer = Buffer::decompress(packageBuffer.subrange(
+            byteIndex, packageBuffer.size() - byteIndex));
+        if (!filebuffer.has_value())
+            return false; // Failure
+
+        // Parse and read-in the packaged files
+        in_files(*filebuffer, m_files);
+        return true; // Success
+    }
 
     // Ensure header title matches
-    if (std::strcmp(packHeaderTitle, "yatta pack") != 0)
+    if (packHeaderTitle != "yatta pack v2")
         return false; // Failure
 
-    // Try to decompress the archive buffer
-    auto filebuffer = Buffer::decompress(
-        packageBuffer.subrange(byteIndex, packageBuffer.size() - byteIndex));
-    if (!filebuffer.has_value())
+    // Parse the package's dictionary and file table
+    const auto table = read_package_table(packageBuffer, byteIndex);
+    if (!table.has_value())
         return false; // Failure
 
-    // Parse and read-in the packaged files
-    in_files(*filebuffer, m_files);
+    // Expand every file against the shared dictionary
+    std::vector<VirtualFile> files;
+    files.reserve(table->entries.size());
+    for (const auto& entry : table->entries) {
+        auto fileBuffer = read_package_entry(packageBuffer, *table, entry);
+        if (!fileBuffer.has_value())
+            return false; // Failure
+        files.emplace_back(VirtualFile{ entry.path, std::move(*fileBuffer) });
+    }
+    m_files.insert(
+        m_files.end(), std::make_move_iterator(files.begin()),
+        std::make_move_iterator(files.end()));
 
     // Success
     return true;
@@ -478,67 +777,100 @@ bool Directory::out_folder(const filepath& path) const {
     return true; // Success
 }
 
-std::optional<Buffer>
-Directory::out_package(const std::string& folderName) const {
+std::optional<Buffer> Directory::out_package(
+    const std::string& folderName, const MemoryRange& dictionary) const {
     // Ensure we have files to output
     if (m_files.empty())
         return {}; // Failure
 
-    // Create a buffer large enough to hold all the files
+    // Use the supplied dictionary, or build one from the files
+    const Buffer sampledDictionary =
+        dictionary.empty() ? build_dictionary(m_files) : Buffer();
+    const MemoryRange& packDictionary =
+        dictionary.empty() ? sampledDictionary : dictionary;
+
+    // Compress every file independently against the dictionary
     Buffer filebuffer;
-    filebuffer.reserve(std::accumulate(
-        m_files.cbegin(), m_files.cend(),
-        sizeof(size_t), // Starting with the file count
-        [](const size_t& currentSize, const VirtualFile& file) noexcept {
-            return currentSize + sizeof(size_t)                  // Path Size
-                   + (sizeof(char) * file.m_relativePath.size()) // Path
-                   + sizeof(size_t) // Path Size again for bidirectional reading
-                   + sizeof(size_t) // File Size
-                   + (sizeof(std::byte) * file.m_data.size()); // File Data
-        }));
-
-    // Starting with the file count
-    filebuffer.push_type(m_files.size());
-
-    // Iterate over all files, writing in all their data
-    for (auto& file : m_files) {
-        filebuffer.push_type(file.m_relativePath);
-        filebuffer.push_type(file.m_data.size());
-        filebuffer.push_raw(file.m_data.bytes(), file.m_data.size());
+    Buffer scratchBuffer;
+    std::vector<PackageEntry> entries;
+    entries.reserve(m_files.size());
+    for (const auto& file : m_files) {
+        PackageEntry entry{ file.m_relativePath, file.m_data.size(),
+                            filebuffer.size(), 0ULL };
+        if (file.m_data.hasData()) {
+            const auto bound = Buffer::compressBound(entry.size);
+            if (scratchBuffer.size() < bound) {
+                scratchBuffer.reserve(bound);
+                scratchBuffer.resize(bound);
+            }
+            const auto compressedSize = Buffer::compress(
+                file.m_data, scratchBuffer, packDictionary, yatta::Codec::LZ4);
+            if (!compressedSize.has_value())
+                return {}; // Failure
+            entry.compressedSize = *compressedSize;
+            filebuffer.push_raw(scratchBuffer.bytes(), entry.compressedSize);
+        }
+        entries.emplace_back(std::move(entry));
     }
 
-    // Try to compress the archive buffer
-    if (auto result = filebuffer.compress())
-        std::swap(filebuffer, *result);
-    else
-        return {}; // Failure
+    // Compress the dictionary itself, it's only stored once
+    Buffer compressedDictionary;
+    if (packDictionary.hasData()) {
+        if (auto result = Buffer::compress(packDictionary))
+            std::swap(compressedDictionary, *result);
+        else
+            return {}; // Failure
+    }
 
-    // Prepend header information
-    constexpr char packHeaderTitle[16ULL] = "yatta pack\0";
+    // Write header information
+    constexpr char packHeaderTitle[16ULL] = "yatta pack v2\0";
     const auto& packHeaderName = folderName;
-    const size_t headerSize = sizeof(packHeaderTitle) + sizeof(size_t) +
-                              (sizeof(char) * folderName.size()) +
-                              sizeof(size_t);
+    const size_t headerSize = std::accumulate(
+        entries.cbegin(), entries.cend(),
+        sizeof(packHeaderTitle) + sizeof(size_t) +
+            (sizeof(char) * folderName.size()) + sizeof(size_t) +
+            sizeof(size_t) + compressedDictionary.size() + sizeof(size_t),
+        [](const size_t& currentSize, const PackageEntry& entry) noexcept {
+            return currentSize + sizeof(size_t)            // Path Size
+                   + (sizeof(char) * entry.path.size())    // Path
+                   + sizeof(size_t)                        // Path Size again
+                   + (sizeof(size_t) * 3ULL); // Size, Offset, Compressed Size
+        });
     Buffer bufferWithHeader;
-    bufferWithHeader.reserve(filebuffer.size() + headerSize);
-
-    // Copy header data into new buffer at the beginning
+    bufferWithHeader.reserve(headerSize + filebuffer.size());
     bufferWithHeader.push_type(packHeaderTitle);
     bufferWithHeader.push_type(packHeaderName);
-    bufferWithHeader.push_raw(filebuffer.bytes(), filebuffer.size());
+
+    // Write the dictionary
+    bufferWithHeader.push_type(compressedDictionary.size());
+    if (compressedDictionary.hasData())
+        bufferWithHeader.push_raw(
+            compressedDictionary.bytes(), compressedDictionary.size());
+
+    // Write the file table, followed by the file data
+    bufferWithHeader.push_type(entries.size());
+    for (const auto& entry : entries) {
+        bufferWithHeader.push_type(entry.path);
+        bufferWithHeader.push_type(entry.size);
+        bufferWithHeader.push_type(entry.offset);
+        bufferWithHeader.push_type(entry.compressedSize);
+    }
+    if (filebuffer.hasData())
+        bufferWithHeader.push_raw(filebuffer.bytes(), filebuffer.size());
 
     return bufferWithHeader; // Success
 }
 
-std::optional<Buffer>
-Directory::out_delta(const Directory& targetDirectory) const {
+std::optional<Buffer> Directory::out_delta(
+    const Directory& targetDirectory,
+    const Buffer::DiffOptions& options) const {
     // Ensure we have files to diff
     if (fileCount() == 0 && targetDirectory.fileCount() == 0)
         return {}; // Failure
 
     // Retrieve all common, added, and removed files as instructions
     auto [instructionBuffer, instCount] =
-        gen_instructions(m_files, targetDirectory.m_files);
+        gen_instructions(m_files, targetDirectory.m_files, options);
 
     // Try to compress the instruction buffer
     if (auto result = instructionBuffer.compress())
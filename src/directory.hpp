@@ -71,6 +71,12 @@ class Directory {
     /** Retrieve the running directory for this application.
     @return                 the directory this application launched from. */
     static std::string GetRunningDirectory() noexcept;
+    /** Retrieve a single file from a package, without expanding the others.
+    @param  packageBuffer   the package to source data from.
+    @param  relativePath    the relative path of the file to retrieve.
+    @return                 the file's data on success, empty otherwise. */
+    static std::optional<Buffer> GetPackagedFile(
+        const Buffer& packageBuffer, const std::string& relativePath);
 
     // Public Manipulation Methods
     /** Remove all files from this directory, freeing its memory. */
@@ -100,15 +106,24 @@ class Directory {
     @return                 true on success, false otherwise. */
     bool out_folder(const std::filesystem::path& path) const;
     /** Generate a package buffer from this directory.
+    Each file is compressed independently against a shared dictionary, stored
+    once in the package, allowing files to be retrieved individually.
     @param  folderName      the name to give this package.
+    @param  dictionary      the dictionary to compress against, if empty one
+    is built from content recurring across this directory's files.
     @return                 packaged version of this directory on success, empty
     otherwise. */
-    std::optional<Buffer> out_package(const std::string& folderName) const;
+    std::optional<Buffer> out_package(
+        const std::string& folderName,
+        const MemoryRange& dictionary = MemoryRange()) const;
     /** Generate a patch buffer from this directory against the specified target
     directory.
     @param  targetDirectory the target to diff against.
+    @param  options         the strategy and tuning to diff each file with.
     @return                 patch buffer on success, empty otherwise. */
-    std::optional<Buffer> out_delta(const Directory& targetDirectory) const;
+    std::optional<Buffer> out_delta(
+        const Directory& targetDirectory,
+        const Buffer::DiffOptions& options = Buffer::DiffOptions()) const;
 
     protected:
     // Protected Attributes
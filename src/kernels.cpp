@@ -0,0 +1,370 @@
+#include "kernels.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#if defined(__x86_64__) || defined(_M_X64)
+#define YATTA_X64
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define YATTA_TARGET(features)
+#else
+#include <cpuid.h>
+#define YATTA_TARGET(features) __attribute__((target(features)))
+#endif
+#include <immintrin.h>
+#endif
+
+// Convenience Definitions
+using yatta::Kernels;
+using InstructionSet = yatta::Kernels::InstructionSet;
+
+// Private Static Methods
+
+/** Count the zero bits below the lowest set bit of a non-zero mask. */
+size_t count_trailing_zeros(const uint64_t& mask) noexcept {
+#if defined(_MSC_VER)
+    unsigned long index(0UL);
+    _BitScanForward64(&index, mask);
+    return static_cast<size_t>(index);
+#else
+    return static_cast<size_t>(__builtin_ctzll(mask));
+#endif
+}
+
+/** Count the zero bits above the highest set bit of a non-zero mask. */
+size_t count_leading_zeros(const uint64_t& mask) noexcept {
+#if defined(_MSC_VER)
+    unsigned long index(0UL);
+    _BitScanReverse64(&index, mask);
+    return 63ULL - static_cast<size_t>(index);
+#else
+    return static_cast<size_t>(__builtin_clzll(mask));
+#endif
+}
+
+/** Read a word from a pointer, which needn't be aligned. */
+size_t read_word(const std::byte* const ptr) noexcept {
+    size_t word(0ULL);
+    std::memcpy(&word, ptr, sizeof(size_t));
+    return word;
+}
+
+/** Count how many bytes match at the start of 2 pointers, a word at a time,
+then a byte at a time past the first mismatching word. */
+size_t scalar_common_prefix(
+    const std::byte* const ptrA, const std::byte* const ptrB,
+    const size_t& maxLength) noexcept {
+    size_t length(0ULL);
+    for (; length + sizeof(size_t) <= maxLength &&
+           read_word(&ptrA[length]) == read_word(&ptrB[length]);
+         length += sizeof(size_t))
+        continue;
+    while (length < maxLength && ptrA[length] == ptrB[length])
+        ++length;
+    return length;
+}
+
+/** Count how many bytes match preceding 2 pointers, a word at a time, then
+a byte at a time past the last mismatching word. */
+size_t scalar_common_suffix(
+    const std::byte* const ptrA, const std::byte* const ptrB,
+    const size_t& maxLength) noexcept {
+    size_t length(0ULL);
+    for (; length + sizeof(size_t) <= maxLength &&
+           read_word(ptrA - length - sizeof(size_t)) ==
+               read_word(ptrB - length - sizeof(size_t));
+         length += sizeof(size_t))
+        continue;
+    while (length < maxLength &&
+           *(ptrA - length - 1ULL) == *(ptrB - length - 1ULL))
+        ++length;
+    return length;
+}
+
+/** Count how many bytes in a row equal a value, a word at a time, then a
+byte at a time past the first mismatching word. */
+size_t scalar_run_length(
+    const std::byte* const ptr, const std::byte& value,
+    const size_t& maxLength) noexcept {
+    const auto pattern =
+        static_cast<size_t>(value) * (SIZE_MAX / static_cast<size_t>(0xFFU));
+    size_t length(0ULL);
+    for (; length + sizeof(size_t) <= maxLength &&
+           read_word(&ptr[length]) == pattern;
+         length += sizeof(size_t))
+        continue;
+    while (length < maxLength && ptr[length] == value)
+        ++length;
+    return length;
+}
+
+#if defined(YATTA_X64)
+/** Retrieve the registers cpuid reports for a leaf and sub-leaf. */
+void read_cpuid(
+    const unsigned int& leaf, const unsigned int& subLeaf,
+    unsigned int (&registers)[4]) noexcept {
+#if defined(_MSC_VER)
+    int values[4] = {};
+    __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subLeaf));
+    for (size_t x = 0ULL; x < 4ULL; ++x)
+        registers[x] = static_cast<unsigned int>(values[x]);
+#else
+    __cpuid_count(
+        leaf, subLeaf, registers[0], registers[1], registers[2],
+        registers[3]);
+#endif
+}
+
+/** Retrieve which register states the operating system saves, which it must
+for the wider registers to be usable. */
+uint64_t read_xcr0() noexcept {
+#if defined(_MSC_VER)
+    return static_cast<uint64_t>(_xgetbv(0U));
+#else
+    uint32_t low(0U);
+    uint32_t high(0U);
+    __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0U));
+    return (static_cast<uint64_t>(high) << 32ULL) | low;
+#endif
+}
+
+/** Count how many bytes match at the start of 2 pointers, 16 at a time. */
+size_t sse2_common_prefix(
+    const std::byte* const ptrA, const std::byte* const ptrB,
+    const size_t& maxLength) noexcept {
+    size_t length(0ULL);
+    for (; length + 16ULL <= maxLength; length += 16ULL) {
+        const auto mask = static_cast<uint64_t>(_mm_movemask_epi8(
+            _mm_cmpeq_epi8(
+                _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(&ptrA[length])),
+                _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(&ptrB[length])))));
+        if (mask != 0xFFFFULL)
+            return length + count_trailing_zeros(~mask);
+    }
+    return length + scalar_common_prefix(
+                        &ptrA[length], &ptrB[length], maxLength - length);
+}
+
+/** Count how many bytes match preceding 2 pointers, 16 at a time. */
+size_t sse2_common_suffix(
+    const std::byte* const ptrA, const std::byte* const ptrB,
+    const size_t& maxLength) noexcept {
+    size_t length(0ULL);
+    for (; length + 16ULL <= maxLength; length += 16ULL) {
+        const auto mask = static_cast<uint64_t>(_mm_movemask_epi8(
+            _mm_cmpeq_epi8(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                    ptrA - length - 16ULL)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                    ptrB - length - 16ULL)))));
+        if (mask != 0xFFFFULL)
+            return length + count_leading_zeros(~mask & 0xFFFFULL) - 48ULL;
+    }
+    return length + scalar_common_suffix(
+                        ptrA - length, ptrB - length, maxLength - length);
+}
+
+/** Count how many bytes in a row equal a value, 16 at a time. */
+size_t sse2_run_length(
+    const std::byte* const ptr, const std::byte& value,
+    const size_t& maxLength) noexcept {
+    const auto pattern = _mm_set1_epi8(static_cast<char>(value));
+    size_t length(0ULL);
+    for (; length + 16ULL <= maxLength; length += 16ULL) {
+        const auto mask = static_cast<uint64_t>(_mm_movemask_epi8(
+            _mm_cmpeq_epi8(
+                _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(&ptr[length])),
+                pattern)));
+        if (mask != 0xFFFFULL)
+            return length + count_trailing_zeros(~mask);
+    }
+    return length +
+           scalar_run_length(&ptr[length], value, maxLength - length);
+}
+
+/** Count how many bytes match at the start of 2 pointers, 32 at a time. */
+YATTA_TARGET("avx2")
+size_t avx2_common_prefix(
+    const std::byte* const ptrA, const std::byte* const ptrB,
+    const size_t& maxLength) noexcept {
+    size_t length(0ULL);
+    for (; length + 32ULL <= maxLength; length += 32ULL) {
+        const auto mask = static_cast<uint64_t>(
+            static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(&ptrA[length])),
+                _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(&ptrB[length]))))));
+        if (mask != 0xFFFFFFFFULL)
+            return length + count_trailing_zeros(~mask);
+    }
+    return length + sse2_common_prefix(
+                        &ptrA[length], &ptrB[length], maxLength - length);
+}
+
+/** Count how many bytes match preceding 2 pointers, 32 at a time. */
+YATTA_TARGET("avx2")
+size_t avx2_common_suffix(
+    const std::byte* const ptrA, const std::byte* const ptrB,
+    const size_t& maxLength) noexcept {
+    size_t length(0ULL);
+    for (; length + 32ULL <= maxLength; length += 32ULL) {
+        const auto mask = static_cast<uint64_t>(
+            static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(
+                    ptrA - length - 32ULL)),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(
+                    ptrB - length - 32ULL))))));
+        if (mask != 0xFFFFFFFFULL)
+            return length + count_leading_zeros(~mask & 0xFFFFFFFFULL) -
+                   32ULL;
+    }
+    return length + sse2_common_suffix(
+                        ptrA - length, ptrB - length, maxLength - length);
+}
+
+/** Count how many bytes in a row equal a value, 32 at a time. */
+YATTA_TARGET("avx2")
+size_t avx2_run_length(
+    const std::byte* const ptr, const std::byte& value,
+    const size_t& maxLength) noexcept {
+    const auto pattern = _mm256_set1_epi8(static_cast<char>(value));
+    size_t length(0ULL);
+    for (; length + 32ULL <= maxLength; length += 32ULL) {
+        const auto mask = static_cast<uint64_t>(
+            static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(&ptr[length])),
+                pattern))));
+        if (mask != 0xFFFFFFFFULL)
+            return length + count_trailing_zeros(~mask);
+    }
+    return length +
+           sse2_run_length(&ptr[length], value, maxLength - length);
+}
+
+/** Retrieve a mask of the lowest lanes, for loading fewer than 64 bytes. */
+constexpr uint64_t lane_mask(const size_t& lanes) noexcept {
+    return lanes >= 64ULL ? ~0ULL : (1ULL << lanes) - 1ULL;
+}
+
+/** Count how many bytes match at the start of 2 pointers, 64 at a time,
+loading only the bytes left at the end. */
+YATTA_TARGET("avx512f,avx512bw")
+size_t avx512_common_prefix(
+    const std::byte* const ptrA, const std::byte* const ptrB,
+    const size_t& maxLength) noexcept {
+    for (size_t length = 0ULL; length < maxLength; length += 64ULL) {
+        const auto lanes = lane_mask(maxLength - length);
+        const auto equal = static_cast<uint64_t>(_mm512_mask_cmpeq_epi8_mask(
+            lanes, _mm512_maskz_loadu_epi8(lanes, &ptrA[length]),
+            _mm512_maskz_loadu_epi8(lanes, &ptrB[length])));
+        if (equal != lanes)
+            return length + count_trailing_zeros(~equal);
+    }
+    return maxLength;
+}
+
+/** Count how many bytes match preceding 2 pointers, 64 at a time, loading
+only the bytes left at the beginning. */
+YATTA_TARGET("avx512f,avx512bw")
+size_t avx512_common_suffix(
+    const std::byte* const ptrA, const std::byte* const ptrB,
+    const size_t& maxLength) noexcept {
+    for (size_t length = 0ULL; length < maxLength; length += 64ULL) {
+        const auto count = std::min<size_t>(64ULL, maxLength - length);
+        const auto lanes = lane_mask(count);
+        const auto equal = static_cast<uint64_t>(_mm512_mask_cmpeq_epi8_mask(
+            lanes, _mm512_maskz_loadu_epi8(lanes, ptrA - length - count),
+            _mm512_maskz_loadu_epi8(lanes, ptrB - length - count)));
+        if (equal != lanes)
+            return length + count_leading_zeros(~equal & lanes) -
+                   (64ULL - count);
+    }
+    return maxLength;
+}
+
+/** Count how many bytes in a row equal a value, 64 at a time, loading only
+the bytes left at the end. */
+YATTA_TARGET("avx512f,avx512bw")
+size_t avx512_run_length(
+    const std::byte* const ptr, const std::byte& value,
+    const size_t& maxLength) noexcept {
+    const auto pattern = _mm512_set1_epi8(static_cast<char>(value));
+    for (size_t length = 0ULL; length < maxLength; length += 64ULL) {
+        const auto lanes = lane_mask(maxLength - length);
+        const auto equal = static_cast<uint64_t>(_mm512_mask_cmpeq_epi8_mask(
+            lanes, _mm512_maskz_loadu_epi8(lanes, &ptr[length]), pattern));
+        if (equal != lanes)
+            return length + count_trailing_zeros(~equal);
+    }
+    return maxLength;
+}
+#endif
+
+// Public Static Methods
+
+bool Kernels::supported(const InstructionSet& instructionSet) noexcept {
+#if defined(YATTA_X64)
+    // SSE2 is part of x86-64 itself
+    if (instructionSet == InstructionSet::SCALAR ||
+        instructionSet == InstructionSet::SSE2)
+        return true;
+
+    // Ensure the CPU has the instructions, and the OS saves their registers
+    unsigned int registers[4] = {};
+    read_cpuid(0U, 0U, registers);
+    if (registers[0] < 7U)
+        return false; // Failure
+    read_cpuid(1U, 0U, registers);
+    constexpr unsigned int osxsave = 1U << 27U;
+    constexpr unsigned int avx = 1U << 28U;
+    if ((registers[2] & (osxsave | avx)) != (osxsave | avx))
+        return false; // Failure
+    const auto xcr0 = read_xcr0();
+    read_cpuid(7U, 0U, registers);
+    if (instructionSet == InstructionSet::AVX2)
+        return (xcr0 & 0x6ULL) == 0x6ULL && (registers[1] & (1U << 5U)) != 0U;
+    constexpr unsigned int avx512 = (1U << 16U) | (1U << 30U);
+    return instructionSet == InstructionSet::AVX512 &&
+           (xcr0 & 0xE6ULL) == 0xE6ULL &&
+           (registers[1] & avx512) == avx512;
+#else
+    return instructionSet == InstructionSet::SCALAR;
+#endif
+}
+
+std::optional<Kernels::Table>
+Kernels::table(const InstructionSet& instructionSet) noexcept {
+    if (!supported(instructionSet))
+        return {}; // Failure
+#if defined(YATTA_X64)
+    if (instructionSet == InstructionSet::SSE2)
+        return Table{ instructionSet, sse2_common_prefix, sse2_common_suffix,
+                      sse2_run_length };
+    if (instructionSet == InstructionSet::AVX2)
+        return Table{ instructionSet, avx2_common_prefix, avx2_common_suffix,
+                      avx2_run_length };
+    if (instructionSet == InstructionSet::AVX512)
+        return Table{ instructionSet, avx512_common_prefix,
+                      avx512_common_suffix, avx512_run_length };
+#endif
+    return Table{ InstructionSet::SCALAR, scalar_common_prefix,
+                  scalar_common_suffix, scalar_run_length };
+}
+
+const Kernels::Table& Kernels::table() noexcept {
+    // Select the fastest kernels just once, as the CPU won't change
+    static const auto selected = []() noexcept {
+        for (const auto& instructionSet :
+             { InstructionSet::AVX512, InstructionSet::AVX2,
+               InstructionSet::SSE2 })
+            if (const auto kernels = table(instructionSet))
+                return *kernels;
+        return *table(InstructionSet::SCALAR);
+    }();
+    return selected;
+}
\ No newline at end of file
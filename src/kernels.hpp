@@ -0,0 +1,94 @@
+#pragma once
+#ifndef YATTA_KERNELS_H
+#define YATTA_KERNELS_H
+
+#include <cstddef>
+#include <optional>
+
+namespace yatta {
+/** Byte comparison kernels shared by diffing, implemented once per
+instruction set. The fastest set both this build and the CPU support is
+selected at runtime, falling back to portable scalar code elsewhere. */
+class Kernels {
+    public:
+    // Public Enumerations
+    /** Instruction sets the kernels are implemented with, slowest first. */
+    enum class InstructionSet { SCALAR, SSE2, AVX2, AVX512 };
+
+    // Public Type Definitions
+    /** Compares the bytes of 2 pointers, up to a maximum. */
+    using CompareKernel = size_t (*)(
+        const std::byte* ptrA, const std::byte* ptrB,
+        const size_t& maxLength) noexcept;
+    /** Compares the bytes of a pointer to a value, up to a maximum. */
+    using ScanKernel = size_t (*)(
+        const std::byte* ptr, const std::byte& value,
+        const size_t& maxLength) noexcept;
+
+    // Public Structures
+    /** Every kernel, as implemented with a single instruction set. */
+    struct Table {
+        /** The instruction set the kernels are implemented with. */
+        InstructionSet m_instructionSet = InstructionSet::SCALAR;
+        /** Count how many bytes match at the start of 2 pointers, searching
+        forwards for the first mismatch. */
+        CompareKernel m_commonPrefix = nullptr;
+        /** Count how many bytes match preceding 2 pointers, searching
+        backwards for the last mismatch. */
+        CompareKernel m_commonSuffix = nullptr;
+        /** Count how many bytes in a row equal a value. */
+        ScanKernel m_runLength = nullptr;
+    };
+
+    // Public Static Methods
+    /** Check if both this build and the CPU support an instruction set.
+    @param  instructionSet  the instruction set to check.
+    @return                 true if supported, false otherwise. */
+    [[nodiscard]] static bool
+    supported(const InstructionSet& instructionSet) noexcept;
+    /** Retrieve the kernels implemented with an instruction set.
+    @param  instructionSet  the instruction set to retrieve kernels for.
+    @return                 the kernels if supported, empty otherwise. */
+    [[nodiscard]] static std::optional<Table>
+    table(const InstructionSet& instructionSet) noexcept;
+    /** Retrieve the kernels of the fastest instruction set supported, which
+    are selected the first time they're needed.
+    @return                 the selected kernels. */
+    [[nodiscard]] static const Table& table() noexcept;
+    /** Count how many bytes match at the start of 2 pointers, up to a
+    maximum, using the selected kernels.
+    @param  ptrA            the first pointer to compare.
+    @param  ptrB            the second pointer to compare.
+    @param  maxLength       the most bytes to compare.
+    @return                 the length of the common prefix. */
+    [[nodiscard]] static size_t commonPrefix(
+        const std::byte* ptrA, const std::byte* ptrB,
+        const size_t& maxLength) noexcept {
+        return table().m_commonPrefix(ptrA, ptrB, maxLength);
+    }
+    /** Count how many bytes match preceding 2 pointers, up to a maximum,
+    using the selected kernels.
+    @param  ptrA            the end of the first range to compare.
+    @param  ptrB            the end of the second range to compare.
+    @param  maxLength       the most bytes to compare.
+    @return                 the length of the common suffix. */
+    [[nodiscard]] static size_t commonSuffix(
+        const std::byte* ptrA, const std::byte* ptrB,
+        const size_t& maxLength) noexcept {
+        return table().m_commonSuffix(ptrA, ptrB, maxLength);
+    }
+    /** Count how many bytes in a row equal a value, up to a maximum, using
+    the selected kernels.
+    @param  ptr             the pointer to scan from.
+    @param  value           the value to match.
+    @param  maxLength       the most bytes to scan.
+    @return                 the length of the run. */
+    [[nodiscard]] static size_t runLength(
+        const std::byte* ptr, const std::byte& value,
+        const size_t& maxLength) noexcept {
+        return table().m_runLength(ptr, value, maxLength);
+    }
+};
+}; // namespace yatta
+
+#endif // YATTA_KERNELS_H
\ No newline at end of file
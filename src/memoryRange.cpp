@@ -1,4 +1,6 @@
 #include "memoryRange.hpp"
+#include <array>
+#include <cmath>
 
 // Convenience Definition
 using yatta::MemoryRange;
@@ -41,6 +43,41 @@ size_t MemoryRange::hash() const noexcept {
     return value;
 }
 
+double MemoryRange::entropy() const noexcept {
+    if (m_dataPtr == nullptr || m_range == 0ULL)
+        return 0.0;
+
+    // Sample up to 16 evenly spaced segments of 256 bytes
+    constexpr size_t sampleCount(16ULL);
+    constexpr size_t sampleSize(256ULL);
+    std::array<size_t, 256ULL> histogram{};
+    size_t total(0ULL);
+    if (m_range <= sampleCount * sampleSize) {
+        for (size_t index = 0ULL; index < m_range; ++index)
+            ++histogram[static_cast<size_t>(m_dataPtr[index])];
+        total = m_range;
+    } else {
+        const size_t stride = (m_range - sampleSize) / (sampleCount - 1ULL);
+        for (size_t sample = 0ULL; sample < sampleCount; ++sample) {
+            const auto* const samplePtr = &m_dataPtr[sample * stride];
+            for (size_t index = 0ULL; index < sampleSize; ++index)
+                ++histogram[static_cast<size_t>(samplePtr[index])];
+        }
+        total = sampleCount * sampleSize;
+    }
+
+    // Accumulate Shannon entropy over the byte histogram
+    double value(0.0);
+    for (const auto& count : histogram) {
+        if (count == 0ULL)
+            continue;
+        const auto probability =
+            static_cast<double>(count) / static_cast<double>(total);
+        value -= probability * std::log2(probability);
+    }
+    return value;
+}
+
 // Public Manipulation Methods
 
 std::byte& MemoryRange::operator[](const size_t& byteIndex) {
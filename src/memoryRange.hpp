@@ -52,6 +52,10 @@ class MemoryRange {
     /** Generates a hash value derived from this range's contents.
     @return                 hash value calculated for this range's memory. */
     size_t hash() const noexcept;
+    /** Estimates the order-0 entropy of this range's contents.
+    @note   large ranges are estimated from evenly spaced samples.
+    @return                 estimated entropy, in bits per byte (0 to 8). */
+    double entropy() const noexcept;
 
     // Public Manipulation Methods
     /** Retrieves a reference to the data at the byte index specified.
@@ -6,6 +6,7 @@
 #include <atomic>
 #include <deque>
 #include <functional>
+#include <mutex>
 #include <shared_mutex>
 #include <thread>
 #include <vector>
@@ -3,7 +3,9 @@
 #define YATTA_H
 
 #include "buffer.hpp"
+#include "codec.hpp"
 #include "directory.hpp"
+#include "kernels.hpp"
 #include "memoryRange.hpp"
 #include "threader.hpp"
 
@@ -1,9 +1,15 @@
 #include "yatta.hpp"
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iostream>
+#include <tuple>
+#include <vector>
 
 // Convenience Definitions
 using yatta::Buffer;
+using yatta::Codec;
+using yatta::MemoryRange;
 
 // Forward Declarations
 void Buffer_ConstructionTest();
@@ -11,7 +17,37 @@ void Buffer_AssignmentTest();
 void Buffer_MethodTest();
 void Buffer_IOTest();
 void Buffer_CompressionTest();
+void Buffer_CodecTest();
+void Buffer_ScratchCompressionTest();
+void Buffer_SeekableCompressionTest();
 void Buffer_DiffTest();
+void Buffer_DiffMatchingTest();
+void Buffer_DiffOptionsTest();
+void Buffer_DiffTrimmingTest();
+void Buffer_HighRatioDiffTest();
+void Buffer_RepeatDiffTest();
+void Buffer_LegacyDiffTest();
+void Buffer_MalformedDiffTest();
+void Buffer_StreamPatchTest();
+void Buffer_ParallelPatchTest();
+void Buffer_InPlacePatchTest();
+void Buffer_DiffIndexTest();
+void Buffer_MultiBaseDiffTest();
+void Buffer_ComposeDiffTest();
+Buffer Buffer_MakeNoise(const size_t& size, size_t seed);
+Buffer Buffer_MakeShifted(const Buffer& source);
+Buffer Buffer_MakeSwapped(const Buffer& source);
+Buffer Buffer_MakeEdited(
+    const Buffer& source, const size_t& stride, const unsigned int& delta);
+Buffer Buffer_MakeMixed(const Buffer& noise, const Buffer& otherNoise);
+Buffer Buffer_MakeText();
+Buffer Buffer_MakePadded();
+Buffer Buffer_MakeLegacyDiff();
+Buffer
+Buffer_WrapLegacyDiff(const Buffer& instructions, const size_t& targetSize);
+Buffer Buffer_LegacyCompress(const Buffer& data);
+std::optional<Buffer>
+Buffer_PatchStream(const MemoryRange& source, const MemoryRange& diff);
 
 // The structure we'll compress, decompress, diff, and patch
 struct TestStructureA {
@@ -39,7 +75,23 @@ int main() {
     Buffer_MethodTest();
     Buffer_IOTest();
     Buffer_CompressionTest();
+    Buffer_CodecTest();
+    Buffer_ScratchCompressionTest();
+    Buffer_SeekableCompressionTest();
     Buffer_DiffTest();
+    Buffer_DiffMatchingTest();
+    Buffer_DiffOptionsTest();
+    Buffer_DiffTrimmingTest();
+    Buffer_HighRatioDiffTest();
+    Buffer_RepeatDiffTest();
+    Buffer_LegacyDiffTest();
+    Buffer_MalformedDiffTest();
+    Buffer_StreamPatchTest();
+    Buffer_ParallelPatchTest();
+    Buffer_InPlacePatchTest();
+    Buffer_DiffIndexTest();
+    Buffer_MultiBaseDiffTest();
+    Buffer_ComposeDiffTest();
     exit(0);
 }
 
@@ -179,6 +231,207 @@ void Buffer_CompressionTest() {
         decompressedBuffer->hash() == buffer.hash());
 }
 
+// A codec which inverts every byte, to test user-registered codecs
+struct Invert_Codec final : public Codec {
+    size_t tag() const noexcept final { return Codec::USER; }
+    size_t bound(const size_t& sourceSize) const noexcept final {
+        return sourceSize;
+    }
+    std::optional<size_t>
+    compress(const MemoryRange& source, MemoryRange& destination) const final {
+        ++m_compressCount;
+        std::transform(
+            source.cbegin(), source.cend(), destination.begin(),
+            [](const std::byte& value) noexcept { return ~value; });
+        return source.size();
+    }
+    bool decompress(
+        const MemoryRange& source, MemoryRange& destination) const final {
+        std::transform(
+            source.cbegin(), source.cend(), destination.begin(),
+            [](const std::byte& value) noexcept { return ~value; });
+        return source.size() == destination.size();
+    }
+    inline static size_t m_compressCount = 0ULL;
+};
+
+void Buffer_CodecTest() {
+    // Create a buffer and load it with repetitive test data
+    Buffer buffer;
+    for (int x = 0; x < 4096; ++x)
+        buffer.push_type(x % 100);
+
+    // Ensure every built-in codec round-trips the data
+    [[maybe_unused]] size_t lz4Size(0ULL);
+    [[maybe_unused]] size_t lz4hcSize(0ULL);
+    for (const auto& tag : { Codec::STORE, Codec::LZ4, Codec::LZ4HC }) {
+        const auto compressedBuffer = buffer.compress(tag);
+        assert(compressedBuffer.has_value());
+        const auto decompressedBuffer = compressedBuffer->decompress();
+        assert(
+            decompressedBuffer.has_value() &&
+            decompressedBuffer->hash() == buffer.hash());
+        if (tag == Codec::LZ4)
+            lz4Size = compressedBuffer->size();
+        else if (tag == Codec::LZ4HC)
+            lz4hcSize = compressedBuffer->size();
+    }
+
+    // Ensure the high-compression codec doesn't do worse than the default
+    assert(lz4hcSize != 0ULL && lz4hcSize <= lz4Size);
+
+    // Ensure we cannot compress with an unregistered codec
+    assert(!buffer.compress(Codec::USER));
+
+    // Ensure user codecs can be registered and are dispatched by tag
+    Codec::Register(std::make_shared<Invert_Codec>());
+    const auto invertedBuffer = buffer.compress(Codec::USER);
+    assert(invertedBuffer.has_value());
+    const auto restoredBuffer = invertedBuffer->decompress();
+    assert(
+        restoredBuffer.has_value() && restoredBuffer->hash() == buffer.hash());
+
+    // Ensure incompressible data never expands beyond the header
+    Buffer noiseBuffer(65536ULL);
+    size_t seed(1234567ULL);
+    for (auto& value : noiseBuffer) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        value = static_cast<std::byte>(seed >> 56ULL);
+    }
+    const auto noiseCompressed = noiseBuffer.compress(Codec::LZ4HC);
+    assert(
+        noiseCompressed.has_value() &&
+        noiseCompressed->size() <= noiseBuffer.size() + 32ULL);
+    const auto noiseDecompressed = noiseCompressed->decompress();
+    assert(
+        noiseDecompressed.has_value() &&
+        noiseDecompressed->hash() == noiseBuffer.hash());
+
+    // Ensure data with a flat byte histogram still shrinks when it repeats
+    Buffer repeatedNoise(1048576ULL);
+    Buffer rampBuffer(1048576ULL);
+    for (size_t x = 0ULL; x < repeatedNoise.size(); ++x) {
+        repeatedNoise[x] = noiseBuffer[x % 8192ULL];
+        rampBuffer[x] = static_cast<std::byte>(x);
+    }
+    for (const auto* flatBuffer : { &repeatedNoise, &rampBuffer }) {
+        const auto flatCompressed = flatBuffer->compress();
+        assert(
+            flatCompressed.has_value() &&
+            flatCompressed->size() < flatBuffer->size() / 16ULL);
+        [[maybe_unused]] const auto flatDecompressed =
+            flatCompressed->decompress();
+        assert(
+            flatDecompressed.has_value() &&
+            flatDecompressed->hash() == flatBuffer->hash());
+    }
+
+    // Ensure only the default codec skips data sampled as incompressible
+    [[maybe_unused]] const auto compressCount = Invert_Codec::m_compressCount;
+    [[maybe_unused]] const auto noiseInverted =
+        noiseBuffer.compress(Codec::USER);
+    assert(
+        noiseInverted.has_value() &&
+        Invert_Codec::m_compressCount == compressCount + 1ULL);
+
+    // Ensure legacy (untagged) LZ4 buffers can still be decompressed
+    const auto lz4Buffer = buffer.compress(Codec::LZ4);
+    constexpr size_t headerSize = 32ULL;
+    [[maybe_unused]] constexpr size_t legacyHeaderSize = 24ULL;
+    constexpr char legacyTitle[16ULL] = "yatta compress";
+    Buffer legacyBuffer;
+    legacyBuffer.push_type(legacyTitle);
+    legacyBuffer.push_type(buffer.size());
+    legacyBuffer.push_raw(
+        &lz4Buffer->bytes()[headerSize], lz4Buffer->size() - headerSize);
+    assert(
+        legacyBuffer.size() + headerSize - legacyHeaderSize ==
+        lz4Buffer->size());
+    const auto legacyResult = legacyBuffer.decompress();
+    assert(legacyResult.has_value() && legacyResult->hash() == buffer.hash());
+}
+
+void Buffer_ScratchCompressionTest() {
+    // Create a buffer and load it with repetitive test data
+    Buffer buffer;
+    for (int x = 0; x < 4096; ++x)
+        buffer.push_type(x % 100);
+
+    // Ensure we cannot compress into a range that is too small
+    Buffer tooSmall(16ULL);
+    assert(!Buffer::compress(buffer, tooSmall));
+
+    // Ensure we can compress into caller-provided memory
+    const auto bound = Buffer::compressBound(buffer.size());
+    assert(bound > buffer.size());
+    Buffer scratch(bound);
+    const auto compressedSize = Buffer::compress(buffer, scratch);
+    assert(compressedSize.has_value() && *compressedSize <= bound);
+
+    // Ensure the scratch result matches the allocating version
+    const auto compressedRange = scratch.subrange(0ULL, *compressedSize);
+    const auto compressedBuffer = buffer.compress();
+    assert(compressedBuffer->hash() == compressedRange.hash());
+
+    // Ensure we can decompress into caller-provided memory, reusing it
+    assert(Buffer::decompressedSize(compressedRange) == buffer.size());
+    Buffer output(buffer.size());
+    for (int x = 0; x < 2; ++x) {
+        [[maybe_unused]] const auto outputSize =
+            Buffer::decompress(compressedRange, output);
+        assert(
+            outputSize == buffer.size() && output.hash() == buffer.hash());
+    }
+
+    // Ensure we cannot decompress into a range that is too small
+    assert(!Buffer::decompress(compressedRange, tooSmall));
+    assert(!Buffer::decompressedSize(tooSmall));
+}
+
+void Buffer_SeekableCompressionTest() {
+    // Create a buffer and load it with repetitive test data
+    Buffer buffer;
+    for (int x = 0; x < 100000; ++x)
+        buffer.push_type(x % 1000);
+
+    // Ensure we cannot compress with an invalid block size or codec
+    assert(!Buffer::compress_seekable(buffer, 0ULL));
+    assert(!Buffer::compress_seekable(buffer, 4096ULL, Codec::USER + 1ULL));
+
+    // Ensure we can compress into small blocks, and expand it all again
+    const auto seekable = Buffer::compress_seekable(buffer, 4096ULL);
+    assert(seekable.has_value() && seekable->size() < buffer.size());
+    assert(Buffer::decompressedSize(*seekable) == buffer.size());
+    const auto decompressed = Buffer::decompress(*seekable);
+    assert(decompressed.has_value() && decompressed->hash() == buffer.hash());
+
+    // Ensure partial ranges match, whether within, across, or along blocks
+    constexpr size_t ranges[][2] = {
+        { 0ULL, 1ULL },       { 100ULL, 200ULL },    { 4000ULL, 200ULL },
+        { 4096ULL, 4096ULL }, { 1000ULL, 50000ULL }, { 399990ULL, 10ULL }
+    };
+    for (const auto& [offset, length] : ranges) {
+        [[maybe_unused]] const auto portion =
+            Buffer::decompress_range(*seekable, offset, length);
+        assert(
+            portion.has_value() &&
+            portion->hash() == buffer.subrange(offset, length).hash());
+    }
+
+    // Ensure ranges of non-seekable buffers can be expanded too
+    const auto compressed = buffer.compress();
+    [[maybe_unused]] const auto portion =
+        Buffer::decompress_range(*compressed, 4000ULL, 200ULL);
+    assert(
+        portion.has_value() &&
+        portion->hash() == buffer.subrange(4000ULL, 200ULL).hash());
+
+    // Ensure we cannot expand empty or out of bounds ranges
+    assert(!Buffer::decompress_range(*seekable, 0ULL, 0ULL));
+    assert(!Buffer::decompress_range(*seekable, 399990ULL, 11ULL));
+    assert(!Buffer::decompress_range(buffer, 0ULL, 1ULL));
+}
+
 void Buffer_DiffTest() {
     // Ensure we cannot diff or patch an empty or incorrect buffer
     Buffer bufferA;
@@ -220,4 +473,557 @@ void Buffer_DiffTest() {
     TestStructureB dataC;
     patchedBuffer->out_type(dataC);
     assert(dataB == dataC && patchedBuffer->hash() == bufferB.hash());
+
+    // Ensure high-ratio patches work for structures and new data too
+    const auto ratioDiff = bufferA.diff(bufferB, Buffer::DiffMode::HIGH_RATIO);
+    assert(ratioDiff.has_value());
+    assert(bufferA.patch(*ratioDiff)->hash() == bufferB.hash());
+    const auto newDataDiff =
+        Buffer().diff(bufferB, Buffer::DiffMode::HIGH_RATIO);
+    assert(newDataDiff.has_value());
+    assert(Buffer().patch(*newDataDiff)->hash() == bufferB.hash());
+}
+
+void Buffer_DiffMatchingTest() {
+    // Create noisy data, and a copy shifted by a single inserted byte
+    const auto noise = Buffer_MakeNoise(65536ULL, 1234ULL);
+    const auto shifted = Buffer_MakeShifted(noise);
+
+    // Ensure shifted data is copied rather than inserted all over again
+    const auto shiftedDiff = noise.diff(shifted);
+    assert(shiftedDiff.has_value() && shiftedDiff->size() < 4096ULL);
+    const auto shiftedPatch = noise.patch(*shiftedDiff);
+    assert(shiftedPatch.has_value() && shiftedPatch->hash() == shifted.hash());
+
+    // Ensure diffs are reproducible, despite being generated in parallel
+    for (int x = 0; x < 8; ++x)
+        assert(noise.diff(shifted)->hash() == shiftedDiff->hash());
+
+    // Ensure edits at unaligned offsets within text keep their neighbours
+    const auto text = Buffer_MakeText();
+    Buffer editedText(text);
+    editedText[1001] = std::byte{ '!' };
+    const auto textDiff = text.diff(editedText);
+    assert(textDiff.has_value() && textDiff->size() < 128ULL);
+    assert(text.patch(*textDiff)->hash() == editedText.hash());
+}
+
+void Buffer_DiffOptionsTest() {
+    // Ensure every preset and tuned option set still round-trips
+    const auto noise = Buffer_MakeNoise(65536ULL, 1234ULL);
+    const auto shifted = Buffer_MakeShifted(noise);
+    auto tunedOptions = Buffer::DiffOptions::Fast();
+    tunedOptions.m_windowSize = 1024ULL;
+    tunedOptions.m_minMatch = 8ULL;
+    tunedOptions.m_threadCount = 1ULL;
+    auto budgetOptions = Buffer::DiffOptions::MaxRatio();
+    budgetOptions.m_memoryBudget = 1ULL;
+    for (const auto& options :
+         { Buffer::DiffOptions::Fast(), Buffer::DiffOptions::Balanced(),
+           Buffer::DiffOptions::MaxRatio(), tunedOptions, budgetOptions }) {
+        const auto optionsDiff = noise.diff(shifted, options);
+        assert(optionsDiff.has_value() && optionsDiff->size() < 4096ULL);
+        assert(noise.patch(*optionsDiff)->hash() == shifted.hash());
+    }
+}
+
+void Buffer_DiffTrimmingTest() {
+    // Ensure identical ranges, or ranges sharing their ends, diff compactly
+    const auto noise = Buffer_MakeNoise(65536ULL, 1234ULL);
+    Buffer grownMiddle;
+    grownMiddle.push_raw(noise.bytes(), 32768ULL);
+    grownMiddle.push_raw("grown", 5ULL);
+    grownMiddle.push_raw(&noise[32768ULL], 32768ULL);
+    Buffer truncated(noise);
+    truncated.resize(noise.size() - 1000ULL);
+    Buffer appended(noise);
+    appended.push_raw("appended", 8ULL);
+    auto inPlaceFastOptions = Buffer::DiffOptions::Fast();
+    inPlaceFastOptions.m_inPlace = true;
+    for (const auto& trimmedTarget :
+         { noise, grownMiddle, truncated, appended })
+        for (const auto& options :
+             { Buffer::DiffOptions::Fast(), Buffer::DiffOptions::MaxRatio(),
+               inPlaceFastOptions }) {
+            const auto trimmedDiff = noise.diff(trimmedTarget, options);
+            assert(trimmedDiff.has_value() && trimmedDiff->size() < 128ULL);
+            Buffer trimmedPatch(noise);
+            if (options.m_inPlace)
+                assert(trimmedPatch.patch_in_place(*trimmedDiff));
+            else
+                trimmedPatch = *noise.patch(*trimmedDiff);
+            assert(trimmedPatch.hash() == trimmedTarget.hash());
+        }
+}
+
+void Buffer_HighRatioDiffTest() {
+    // Ensure sparse byte changes make far smaller high-ratio patches
+    const auto noise = Buffer_MakeNoise(65536ULL, 1234ULL);
+    const auto edited = Buffer_MakeEdited(noise, 100ULL, 1U);
+    const auto fastEditDiff = noise.diff(edited);
+    const auto ratioEditDiff =
+        noise.diff(edited, Buffer::DiffMode::HIGH_RATIO);
+    assert(
+        fastEditDiff.has_value() && ratioEditDiff.has_value() &&
+        ratioEditDiff->size() * 4ULL < fastEditDiff->size());
+    const auto editedPatch = noise.patch(*ratioEditDiff);
+    assert(editedPatch.has_value() && editedPatch->hash() == edited.hash());
+}
+
+void Buffer_RepeatDiffTest() {
+    // Ensure long runs of values or short patterns become compact repeats
+    const auto padded = Buffer_MakePadded();
+    for (const auto& mode :
+         { Buffer::DiffMode::FAST, Buffer::DiffMode::HIGH_RATIO }) {
+        const auto paddedDiff = Buffer().diff(padded, mode);
+        assert(paddedDiff.has_value() && paddedDiff->size() < 128ULL);
+        assert(Buffer().patch(*paddedDiff)->hash() == padded.hash());
+    }
+}
+
+void Buffer_LegacyDiffTest() {
+    // Ensure patches using the older fixed-width encoding still apply
+    const auto text = Buffer_MakeText();
+    const auto legacyDiff = Buffer_MakeLegacyDiff();
+    const auto legacyPatch = text.patch(legacyDiff);
+    assert(legacyPatch.has_value() && legacyPatch->size() == 47ULL);
+    assert(std::memcmp(legacyPatch->bytes(), "New", 3ULL) == 0);
+    assert(std::equal(
+        legacyPatch->cbegin() + 3ULL, legacyPatch->cend(), text.cbegin()));
+}
+
+void Buffer_MalformedDiffTest() {
+    // Ensure patches reading past their source are rejected
+    const auto text = Buffer_MakeText();
+    Buffer overreadInstructions;
+    overreadInstructions.push_type('C');
+    overreadInstructions.push_type(0ULL);
+    overreadInstructions.push_type(0ULL);
+    overreadInstructions.push_type(text.size() + 1ULL);
+    const auto overreadDiff =
+        Buffer_WrapLegacyDiff(overreadInstructions, text.size() + 1ULL);
+    assert(!text.patch(overreadDiff).has_value());
+
+    // Ensure patches writing past their target, or cut short, are rejected
+    Buffer overwriteInstructions;
+    overwriteInstructions.push_type('R');
+    overwriteInstructions.push_type(40ULL);
+    overwriteInstructions.push_type(16ULL);
+    overwriteInstructions.push_type(std::byte{ 1 });
+    const auto overwriteDiff =
+        Buffer_WrapLegacyDiff(overwriteInstructions, 47ULL);
+    assert(!text.patch(overwriteDiff).has_value());
+    const auto legacyDiff = Buffer_MakeLegacyDiff();
+    const auto cutDiff = legacyDiff.subrange(0ULL, legacyDiff.size() - 1ULL);
+    assert(!Buffer::patch(text, cutDiff.subrange(0ULL, 8ULL)).has_value());
+    assert(!Buffer::patch(text, cutDiff).has_value());
+
+    // Ensure repeats with a pattern longer than themselves are rejected by
+    // every way of applying them
+    for ([[maybe_unused]] const auto& [length, valid] :
+         { std::make_pair(8ULL, true), std::make_pair(3ULL, false) }) {
+        Buffer periodInstructions;
+        periodInstructions.push_type('P');
+        periodInstructions.push_type(0ULL);
+        periodInstructions.push_type(length);
+        periodInstructions.push_type(4ULL);
+        periodInstructions.push_raw("abcd", 4ULL);
+        const auto periodDiff = Buffer_WrapLegacyDiff(periodInstructions, 8ULL);
+        assert(text.patch(periodDiff).has_value() == valid);
+        assert(Buffer_PatchStream(text, periodDiff).has_value() == valid);
+    }
+}
+
+void Buffer_StreamPatchTest() {
+    // Ensure streamed patches write the same targets, including large ones
+    const auto noise = Buffer_MakeNoise(65536ULL, 1234ULL);
+    const auto shifted = Buffer_MakeShifted(noise);
+    const auto edited = Buffer_MakeEdited(noise, 100ULL, 1U);
+    const auto padded = Buffer_MakePadded();
+    const auto text = Buffer_MakeText();
+    const auto legacyDiff = Buffer_MakeLegacyDiff();
+    const auto largeNoise = Buffer_MakeNoise(1048576ULL, 5678ULL);
+    const auto shiftedDiff = noise.diff(shifted);
+    const std::vector<std::tuple<Buffer, Buffer, Buffer>> streamCases{
+        { noise, *shiftedDiff, shifted },
+        { noise, *noise.diff(edited, Buffer::DiffMode::HIGH_RATIO), edited },
+        { Buffer(), *Buffer().diff(padded), padded },
+        { text, legacyDiff, *text.patch(legacyDiff) },
+        { Buffer(), *Buffer().diff(largeNoise), largeNoise }
+    };
+    for ([[maybe_unused]] const auto& [source, streamDiff, target] :
+         streamCases)
+        assert(Buffer_PatchStream(source, streamDiff)->hash() == target.hash());
+
+    // Ensure older diffs, which may be out of target order, are patched whole
+    // and passed to the sink at once
+    [[maybe_unused]] size_t legacyPortions(0ULL);
+    assert(Buffer::patch_stream(
+        text, legacyDiff, [&](const MemoryRange& portion) {
+            ++legacyPortions;
+            return portion.size() == 47ULL;
+        }));
+    assert(legacyPortions == 1ULL);
+
+    // Ensure sinks may stop a streamed patch
+    assert(!Buffer::patch_stream(
+        noise, *shiftedDiff,
+        [](const MemoryRange& /*unused*/) { return false; }));
+}
+
+void Buffer_ParallelPatchTest() {
+    // Ensure patches spanning many parallel jobs apply in full
+    const auto largeNoise = Buffer_MakeNoise(1048576ULL, 5678ULL);
+    Buffer largeEdited;
+    for (int x = 0; x < 4; ++x) {
+        largeEdited.push_raw("edit", 4ULL);
+        largeEdited.push_raw(largeNoise.bytes(), largeNoise.size());
+    }
+    const auto largeEditDiff = largeNoise.diff(largeEdited);
+    assert(largeEditDiff.has_value());
+    assert(largeNoise.patch(*largeEditDiff)->hash() == largeEdited.hash());
+}
+
+void Buffer_InPlacePatchTest() {
+    // Ensure in-place patches overwrite their source, even when copies would
+    // overwrite each other's source, like swapped halves
+    const auto noise = Buffer_MakeNoise(65536ULL, 1234ULL);
+    const auto shifted = Buffer_MakeShifted(noise);
+    const auto edited = Buffer_MakeEdited(noise, 100ULL, 1U);
+    const auto padded = Buffer_MakePadded();
+    const auto swapped = Buffer_MakeSwapped(noise);
+    auto inPlaceOptions = Buffer::DiffOptions::Balanced();
+    inPlaceOptions.m_inPlace = true;
+    auto inPlaceRatioOptions = Buffer::DiffOptions::MaxRatio();
+    inPlaceRatioOptions.m_inPlace = true;
+    const std::vector<std::tuple<Buffer, Buffer, Buffer::DiffOptions>>
+        inPlaceCases{ { noise, shifted, inPlaceOptions },
+                      { shifted, noise, inPlaceOptions },
+                      { noise, swapped, inPlaceOptions },
+                      { noise, edited, inPlaceRatioOptions },
+                      { Buffer(), padded, inPlaceOptions } };
+    for (const auto& [source, target, options] : inPlaceCases) {
+        const auto inPlaceDiff = source.diff(target, options);
+        assert(inPlaceDiff.has_value());
+        Buffer patched(source);
+        assert(patched.patch_in_place(*inPlaceDiff));
+        assert(patched.hash() == target.hash());
+        assert(source.patch(*inPlaceDiff)->hash() == target.hash());
+    }
+
+    // Ensure only in-place patches apply in place, and they can't be streamed
+    Buffer notInPlace(noise);
+    assert(!notInPlace.patch_in_place(*noise.diff(shifted)));
+    assert(!Buffer::patch_stream(
+        noise, *noise.diff(swapped, inPlaceOptions),
+        [](const MemoryRange& /*unused*/) { return true; }));
+}
+
+void Buffer_DiffIndexTest() {
+    // Ensure one source index may be reused to diff many targets
+    const auto noise = Buffer_MakeNoise(65536ULL, 1234ULL);
+    const auto shifted = Buffer_MakeShifted(noise);
+    const auto edited = Buffer_MakeEdited(noise, 100ULL, 1U);
+    const auto swapped = Buffer_MakeSwapped(noise);
+    Buffer grownMiddle;
+    grownMiddle.push_raw(noise.bytes(), 32768ULL);
+    grownMiddle.push_raw("grown", 5ULL);
+    grownMiddle.push_raw(&noise[32768ULL], 32768ULL);
+    auto tinyRatioOptions = Buffer::DiffOptions::MaxRatio();
+    tinyRatioOptions.m_memoryBudget = 1ULL;
+    auto tinyOptions = Buffer::DiffOptions::Balanced();
+    tinyOptions.m_memoryBudget = 4096ULL;
+    auto smallWindowOptions = Buffer::DiffOptions::Fast();
+    smallWindowOptions.m_windowSize = 1000ULL;
+    for (const auto& options :
+         { Buffer::DiffOptions::Balanced(), Buffer::DiffOptions::MaxRatio(),
+           tinyRatioOptions, tinyOptions, smallWindowOptions }) {
+        const Buffer::DiffIndex noiseIndex(noise, options);
+        assert(noiseIndex.source().bytes() == noise.bytes());
+        assert(noiseIndex.hasSuffixArray() ==
+               (options.m_mode == Buffer::DiffMode::HIGH_RATIO &&
+                options.m_memoryBudget != 1ULL));
+        for (const auto& target :
+             { noise, shifted, edited, grownMiddle, swapped }) {
+            const auto indexedDiff = Buffer::diff(noiseIndex, target, options);
+            assert(indexedDiff.has_value());
+            assert(noise.patch(*indexedDiff)->hash() == target.hash());
+        }
+    }
+}
+
+void Buffer_MultiBaseDiffTest() {
+    // Ensure diffs against several bases copy from each, even across them
+    const auto noise = Buffer_MakeNoise(65536ULL, 1234ULL);
+    const auto otherNoise = Buffer_MakeNoise(65536ULL, 4321ULL);
+    const auto mixed = Buffer_MakeMixed(noise, otherNoise);
+    const std::vector<MemoryRange> bases{ noise, MemoryRange(), otherNoise };
+    for (const auto& options :
+         { Buffer::DiffOptions::Fast(), Buffer::DiffOptions::Balanced(),
+           Buffer::DiffOptions::MaxRatio() }) {
+        const auto basesDiff = Buffer::diff(bases, mixed, options);
+        assert(basesDiff.has_value() && basesDiff->size() < 1024ULL);
+        assert(Buffer::patch(bases, *basesDiff)->hash() == mixed.hash());
+        assert(basesDiff->size() < noise.diff(mixed, options)->size());
+        assert(basesDiff->size() < otherNoise.diff(mixed, options)->size());
+    }
+
+    // Ensure missing bases may be left empty, unless they're read from
+    const auto otherDiff =
+        Buffer::diff(bases, otherNoise.subrange(4096ULL, 32768ULL));
+    assert(otherDiff.has_value());
+    assert(
+        Buffer::patch({ MemoryRange(), MemoryRange(), otherNoise }, *otherDiff)
+            ->hash() == otherNoise.subrange(4096ULL, 32768ULL).hash());
+    const auto basesDiff = Buffer::diff(bases, mixed);
+    assert(!Buffer::patch({ MemoryRange(), MemoryRange(), otherNoise },
+                          *basesDiff)
+                .has_value());
+
+    // Ensure independent bases' diffs patch from any one base present
+    auto independentOptions = Buffer::DiffOptions::Balanced();
+    independentOptions.m_independentBases = true;
+    const auto independentDiff =
+        Buffer::diff({ noise, otherNoise }, mixed, independentOptions);
+    assert(independentDiff.has_value());
+    for ([[maybe_unused]] const auto& presentBases :
+         { std::vector<MemoryRange>{ noise, otherNoise },
+           std::vector<MemoryRange>{ noise, MemoryRange() },
+           std::vector<MemoryRange>{ MemoryRange(), otherNoise } })
+        assert(
+            Buffer::patch(presentBases, *independentDiff)->hash() ==
+            mixed.hash());
+    assert(!Buffer::patch({ MemoryRange(), MemoryRange() }, *independentDiff)
+                .has_value());
+    assert(!Buffer::patch(
+                { Buffer_MakeShifted(noise), otherNoise }, *independentDiff)
+                .has_value());
+    const auto emptyBaseDiff =
+        Buffer::diff(bases, mixed, independentOptions);
+    assert(
+        Buffer::patch(
+            { MemoryRange(), MemoryRange(), MemoryRange() }, *emptyBaseDiff)
+            ->hash() == mixed.hash());
+    assert(!Buffer::patch(noise, *independentDiff).has_value());
+
+    // Ensure the first base present is patched from, before any later base
+    // or any base diffed while empty, so a stand-in there shows in the target
+    const auto standIn = Buffer_MakeNoise(65536ULL, 5678ULL);
+    assert(
+        Buffer::patch({ noise, MemoryRange(), standIn }, *emptyBaseDiff)
+            ->hash() == mixed.hash());
+    for ([[maybe_unused]] const auto& standInBases :
+         { std::vector<MemoryRange>{ standIn, MemoryRange(), otherNoise },
+           std::vector<MemoryRange>{ MemoryRange(), MemoryRange(),
+                                     standIn } }) {
+        [[maybe_unused]] const auto standInTarget =
+            Buffer::patch(standInBases, *emptyBaseDiff);
+        assert(
+            standInTarget.has_value() && standInTarget->hash() != mixed.hash());
+    }
+
+    // Ensure bases must match the diff, and it can't be applied otherwise
+    [[maybe_unused]] auto inPlaceOptions = Buffer::DiffOptions::Balanced();
+    inPlaceOptions.m_inPlace = true;
+    assert(!Buffer::patch({ noise, otherNoise }, *basesDiff).has_value());
+    assert(!Buffer::patch({ noise, MemoryRange(), Buffer_MakeShifted(noise) },
+                          *basesDiff)
+                .has_value());
+    assert(!Buffer::patch(noise, *basesDiff).has_value());
+    assert(!Buffer::patch(bases, *noise.diff(Buffer_MakeShifted(noise)))
+                .has_value());
+    assert(!Buffer::diff(std::vector<MemoryRange>(), mixed).has_value());
+    assert(!Buffer::diff(bases, mixed, inPlaceOptions).has_value());
+}
+
+void Buffer_ComposeDiffTest() {
+    // Ensure composed diffs patch straight to the final target, whichever
+    // instructions either diff used
+    const auto noise = Buffer_MakeNoise(65536ULL, 1234ULL);
+    const auto shifted = Buffer_MakeShifted(noise);
+    auto revised = Buffer_MakeEdited(shifted, 64ULL, 2U);
+    const auto padded = Buffer_MakePadded();
+    revised.push_raw(padded.bytes(), padded.size());
+    Buffer final(revised);
+    final.resize(40000ULL);
+    final.push_raw(&revised[20000ULL], 20000ULL);
+    final.push_raw("final", 5ULL);
+    auto inPlaceOptions = Buffer::DiffOptions::Balanced();
+    inPlaceOptions.m_inPlace = true;
+    auto inPlaceRatioOptions = Buffer::DiffOptions::MaxRatio();
+    inPlaceRatioOptions.m_inPlace = true;
+    for (const auto& firstOptions : { Buffer::DiffOptions::Balanced(),
+                                      Buffer::DiffOptions::MaxRatio(),
+                                      inPlaceRatioOptions })
+        for (const auto& secondOptions : { Buffer::DiffOptions::Fast(),
+                                           Buffer::DiffOptions::MaxRatio(),
+                                           inPlaceOptions }) {
+            const auto firstDiff = noise.diff(shifted, firstOptions);
+            const auto secondDiff = shifted.diff(revised, secondOptions);
+            const auto composed = Buffer::compose(*firstDiff, *secondDiff);
+            assert(composed.has_value());
+            assert(noise.patch(*composed)->hash() == revised.hash());
+            assert(
+                Buffer_PatchStream(noise, *composed)->hash() ==
+                revised.hash());
+
+            // Compose a third diff onto the composition
+            const auto thirdDiff = revised.diff(final, secondOptions);
+            const auto recomposed = Buffer::compose(*composed, *thirdDiff);
+            assert(recomposed.has_value());
+            assert(noise.patch(*recomposed)->hash() == final.hash());
+        }
+
+    // Ensure older diffs compose too, leaving ranges they never wrote zero
+    const auto text = Buffer_MakeText();
+    Buffer gapInstructions;
+    gapInstructions.push_type('I');
+    gapInstructions.push_type(0ULL);
+    gapInstructions.push_type(3ULL);
+    gapInstructions.push_raw("New", 3ULL);
+    gapInstructions.push_type('C');
+    gapInstructions.push_type(13ULL);
+    gapInstructions.push_type(0ULL);
+    gapInstructions.push_type(34ULL);
+    const auto gapDiff = Buffer_WrapLegacyDiff(gapInstructions, 47ULL);
+    const auto gapPatch = text.patch(gapDiff);
+    assert(gapPatch.has_value() && (*gapPatch)[8] == std::byte{ 0 });
+    auto gapTarget = Buffer_MakeEdited(*gapPatch, 5ULL, 1U);
+    gapTarget.push_raw(gapPatch->bytes(), gapPatch->size());
+    for (const auto& options :
+         { Buffer::DiffOptions::Balanced(), Buffer::DiffOptions::MaxRatio() }) {
+        const auto gapComposed =
+            Buffer::compose(gapDiff, *gapPatch->diff(gapTarget, options));
+        assert(gapComposed.has_value());
+        assert(text.patch(*gapComposed)->hash() == gapTarget.hash());
+    }
+
+    // Ensure diffs which don't follow one another, or read several bases,
+    // can't be composed
+    Buffer editedText(text);
+    editedText[1001] = std::byte{ '!' };
+    const auto textDiff = text.diff(editedText);
+    const auto shiftedDiff = noise.diff(shifted);
+    const auto basesDiff = Buffer::diff(
+        { noise, Buffer_MakeNoise(65536ULL, 4321ULL) },
+        Buffer_MakeMixed(noise, Buffer_MakeNoise(65536ULL, 4321ULL)));
+    assert(!Buffer::compose(*textDiff, *shiftedDiff).has_value());
+    assert(!Buffer::compose(*basesDiff, *textDiff).has_value());
+    assert(!Buffer::compose(*shiftedDiff, Buffer()).has_value());
+}
+
+Buffer Buffer_MakeNoise(const size_t& size, size_t seed) {
+    Buffer noise(size);
+    for (auto& value : noise) {
+        seed = (seed * 6364136223846793005ULL) + 1442695040888963407ULL;
+        value = static_cast<std::byte>(seed >> 56ULL);
+    }
+    return noise;
+}
+
+Buffer Buffer_MakeShifted(const Buffer& source) {
+    Buffer shifted;
+    shifted.push_type(std::byte{ 1 });
+    shifted.push_raw(source.bytes(), source.size());
+    return shifted;
+}
+
+Buffer Buffer_MakeSwapped(const Buffer& source) {
+    const auto half = source.size() / 2ULL;
+    Buffer swapped;
+    swapped.push_raw(&source[half], source.size() - half);
+    swapped.push_raw(source.bytes(), half);
+    return swapped;
+}
+
+Buffer Buffer_MakeEdited(
+    const Buffer& source, const size_t& stride, const unsigned int& delta) {
+    Buffer edited(source);
+    for (size_t x = 0ULL; x < edited.size(); x += stride)
+        edited[x] = static_cast<std::byte>(
+            static_cast<unsigned char>(edited[x]) + delta);
+    return edited;
+}
+
+Buffer Buffer_MakeMixed(const Buffer& noise, const Buffer& otherNoise) {
+    Buffer mixed;
+    mixed.push_raw(&otherNoise[32768ULL], 32768ULL);
+    mixed.push_raw("mixed", 5ULL);
+    mixed.push_raw(&noise[16384ULL], 32768ULL);
+    mixed.push_raw(&noise[60000ULL], 5536ULL);
+    mixed.push_raw(otherNoise.bytes(), 4096ULL);
+    return mixed;
+}
+
+Buffer Buffer_MakeText() {
+    Buffer text;
+    for (int x = 0; x < 64; ++x)
+        text.push_raw("The quick brown fox jumps over the lazy dog ", 44ULL);
+    return text;
+}
+
+Buffer Buffer_MakePadded() {
+    Buffer padded;
+    for (size_t x = 0ULL; x < 262144ULL; ++x)
+        padded.push_type(x < 131072ULL ? '\0' : "This is "[x % 8ULL]);
+    return padded;
+}
+
+Buffer Buffer_MakeLegacyDiff() {
+    // Older diffs weren't written in target order
+    Buffer legacyInstructions;
+    legacyInstructions.push_type('C');
+    legacyInstructions.push_type(3ULL);
+    legacyInstructions.push_type(0ULL);
+    legacyInstructions.push_type(44ULL);
+    legacyInstructions.push_type('I');
+    legacyInstructions.push_type(0ULL);
+    legacyInstructions.push_type(3ULL);
+    legacyInstructions.push_raw("New", 3ULL);
+    return Buffer_WrapLegacyDiff(legacyInstructions, 47ULL);
+}
+
+Buffer
+Buffer_WrapLegacyDiff(const Buffer& instructions, const size_t& targetSize) {
+    // Older diffs wrote their instructions after as many zeroed bytes
+    Buffer legacyInstructions(instructions.size());
+    std::fill(
+        legacyInstructions.begin(), legacyInstructions.end(), std::byte{ 0 });
+    legacyInstructions.push_raw(instructions.bytes(), instructions.size());
+    constexpr char legacyTitle[16ULL] = "yatta diff";
+    Buffer legacyDiff;
+    legacyDiff.push_raw(legacyTitle, sizeof(legacyTitle));
+    legacyDiff.push_type(targetSize);
+    const auto legacyData = Buffer_LegacyCompress(legacyInstructions);
+    legacyDiff.push_raw(legacyData.bytes(), legacyData.size());
+    return legacyDiff;
+}
+
+Buffer Buffer_LegacyCompress(const Buffer& data) {
+    // Older compressed buffers held a single LZ4 block, here of literals only
+    constexpr char legacyTitle[16ULL] = "yatta compress";
+    Buffer compressed;
+    compressed.push_raw(legacyTitle, sizeof(legacyTitle));
+    compressed.push_type(data.size());
+    compressed.push_type(
+        static_cast<std::byte>(std::min<size_t>(data.size(), 15ULL) << 4ULL));
+    if (data.size() >= 15ULL) {
+        auto length = data.size() - 15ULL;
+        for (; length >= 255ULL; length -= 255ULL)
+            compressed.push_type(std::byte{ 255 });
+        compressed.push_type(static_cast<std::byte>(length));
+    }
+    compressed.push_raw(data.bytes(), data.size());
+    return compressed;
+}
+
+std::optional<Buffer>
+Buffer_PatchStream(const MemoryRange& source, const MemoryRange& diff) {
+    Buffer streamed;
+    if (!Buffer::patch_stream(source, diff, [&](const MemoryRange& portion) {
+            streamed.push_raw(portion.bytes(), portion.size());
+            return true;
+        }))
+        return {}; // Failure
+    return streamed;
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include "yatta.hpp"
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <fstream>
 #include <iostream>
 
 // Convenience Definitions
@@ -10,6 +13,10 @@ void Directory_ConstructionTest();
 void Directory_MethodTest();
 void Directory_CompressionTest();
 void Directory_DeltaTest();
+yatta::Buffer Directory_MakeLegacyDelta(
+    const std::string& path, const char& flag, const size_t& oldHash,
+    const yatta::Buffer& target, const yatta::Buffer& instructions);
+yatta::Buffer Directory_LegacyCompress(const yatta::Buffer& data);
 
 int main() {
     Directory_ConstructionTest();
@@ -95,6 +102,51 @@ void Directory_CompressionTest() {
     directory = Directory(*package);
     assert(directory.hash() == oldHash);
 
+    // Ensure we can retrieve a single file from a package
+    const auto packagedFile = Directory::GetPackagedFile(*package, "0.png");
+    assert(packagedFile.has_value());
+    std::ifstream file(
+        Directory::GetRunningDirectory() + "/old/0.png", std::ios::binary);
+    const std::string fileData(
+        (std::istreambuf_iterator<char>(file)),
+        std::istreambuf_iterator<char>());
+    assert(
+        packagedFile->size() == fileData.size() &&
+        std::equal(
+            fileData.cbegin(), fileData.cend(),
+            reinterpret_cast<const char*>(packagedFile->bytes())));
+    assert(!Directory::GetPackagedFile(*package, "missing.png"));
+
+    // Ensure we can package against a caller-supplied dictionary
+    yatta::Buffer dictionary(1024ULL);
+    std::fill(dictionary.bytes(), &dictionary.bytes()[1024], std::byte{ 7 });
+    const auto dictionaryPackage = directory.out_package("package", dictionary);
+    assert(dictionaryPackage.has_value());
+    assert(Directory(*dictionaryPackage).hash() == oldHash);
+
+    // Ensure truncated or corrupt packages fail cleanly
+    const size_t headerSize =
+        16ULL + sizeof(size_t) + std::string("package").size() +
+        sizeof(size_t);
+    for (size_t size = headerSize; size < package->size();
+         size += 1ULL + (package->size() / 97ULL)) {
+        yatta::Buffer truncated(size);
+        std::copy(
+            package->bytes(), &package->bytes()[size], truncated.bytes());
+        assert(!Directory().in_package(truncated));
+        assert(!Directory::GetPackagedFile(truncated, "0.png"));
+    }
+    size_t dictionarySize(0ULL);
+    package->out_type(dictionarySize, headerSize);
+    const auto fileCountIndex = headerSize + sizeof(size_t) + dictionarySize;
+    for (const auto& field :
+         { headerSize, fileCountIndex, fileCountIndex + sizeof(size_t) }) {
+        auto corrupt = *package;
+        corrupt.in_type(SIZE_MAX / 2ULL, field);
+        assert(!Directory().in_package(corrupt));
+        assert(!Directory::GetPackagedFile(corrupt, "0.png"));
+    }
+
     // Ensure we can't export an empty directory
     directory.clear();
     assert(!directory.out_folder(""));
@@ -133,4 +185,88 @@ void Directory_DeltaTest() {
     assert(
         oldDirectory.fileSize() == 41970ULL &&
         oldDirectory.fileCount() == 4ULL && oldDirectory.hash() == newHash);
+
+    // Ensure older deltas still apply, which diffed new files against nothing
+    yatta::Buffer addedFile;
+    addedFile.push_raw("added by an older delta", 23ULL);
+    yatta::Buffer addedInstructions;
+    addedInstructions.push_type('I');
+    addedInstructions.push_type(0ULL);
+    addedInstructions.push_type(addedFile.size());
+    addedInstructions.push_raw(addedFile.bytes(), addedFile.size());
+    Directory legacyDirectory;
+    assert(legacyDirectory.in_delta(Directory_MakeLegacyDelta(
+        "added.txt", 'N', 0ULL, addedFile, addedInstructions)));
+    assert(
+        legacyDirectory.fileCount() == 1ULL &&
+        legacyDirectory.fileSize() == addedFile.size());
+
+    // Ensure older deltas still update files, copying out of target order
+    yatta::Buffer updatedFile;
+    updatedFile.push_raw("updated by an older delta", 25ULL);
+    yatta::Buffer updatedInstructions;
+    updatedInstructions.push_type('C');
+    updatedInstructions.push_type(7ULL);
+    updatedInstructions.push_type(5ULL);
+    updatedInstructions.push_type(23ULL);
+    updatedInstructions.push_type('I');
+    updatedInstructions.push_type(0ULL);
+    updatedInstructions.push_type(7ULL);
+    updatedInstructions.push_raw("updated", 7ULL);
+    assert(legacyDirectory.in_delta(Directory_MakeLegacyDelta(
+        "added.txt", 'U', addedFile.hash(), updatedFile,
+        updatedInstructions)));
+    assert(
+        legacyDirectory.fileCount() == 1ULL &&
+        legacyDirectory.fileSize() == updatedFile.size());
+}
+
+yatta::Buffer Directory_MakeLegacyDelta(
+    const std::string& path, const char& flag, const size_t& oldHash,
+    const yatta::Buffer& target, const yatta::Buffer& instructions) {
+    // Older diffs wrote their instructions after as many zeroed bytes
+    yatta::Buffer diffInstructions(instructions.size());
+    std::fill(
+        diffInstructions.begin(), diffInstructions.end(), std::byte{ 0 });
+    diffInstructions.push_raw(instructions.bytes(), instructions.size());
+    constexpr char diffTitle[16ULL] = "yatta diff";
+    yatta::Buffer legacyDiff;
+    legacyDiff.push_raw(diffTitle, sizeof(diffTitle));
+    legacyDiff.push_type(target.size());
+    const auto diffData = Directory_LegacyCompress(diffInstructions);
+    legacyDiff.push_raw(diffData.bytes(), diffData.size());
+
+    // Older deltas held a single instruction per file, compressed the same
+    yatta::Buffer deltaInstructions;
+    deltaInstructions.push_type(path);
+    deltaInstructions.push_type(flag);
+    deltaInstructions.push_type(oldHash);
+    deltaInstructions.push_type(target.hash());
+    deltaInstructions.push_type(legacyDiff.size());
+    deltaInstructions.push_raw(legacyDiff.bytes(), legacyDiff.size());
+    constexpr char deltaTitle[16ULL] = "yatta delta";
+    yatta::Buffer legacyDelta;
+    legacyDelta.push_type(deltaTitle);
+    legacyDelta.push_type(1ULL);
+    const auto deltaData = Directory_LegacyCompress(deltaInstructions);
+    legacyDelta.push_raw(deltaData.bytes(), deltaData.size());
+    return legacyDelta;
+}
+
+yatta::Buffer Directory_LegacyCompress(const yatta::Buffer& data) {
+    // Older compressed buffers held a single LZ4 block, here of literals only
+    constexpr char legacyTitle[16ULL] = "yatta compress";
+    yatta::Buffer compressed;
+    compressed.push_raw(legacyTitle, sizeof(legacyTitle));
+    compressed.push_type(data.size());
+    compressed.push_type(
+        static_cast<std::byte>(std::min<size_t>(data.size(), 15ULL) << 4ULL));
+    if (data.size() >= 15ULL) {
+        auto length = data.size() - 15ULL;
+        for (; length >= 255ULL; length -= 255ULL)
+            compressed.push_type(std::byte{ 255 });
+        compressed.push_type(static_cast<std::byte>(length));
+    }
+    compressed.push_raw(data.bytes(), data.size());
+    return compressed;
 }
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "yatta.hpp"
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+// Convenience Definitions
+using yatta::Kernels;
+using InstructionSet = yatta::Kernels::InstructionSet;
+
+// Forward Declarations
+void Kernels_SelectionTest();
+void Kernels_CommonPrefixTest();
+void Kernels_CommonSuffixTest();
+void Kernels_RunLengthTest();
+std::vector<Kernels::Table> Kernels_Supported();
+std::vector<std::byte> Kernels_MakeBytes(const size_t& size);
+
+int main() {
+    Kernels_SelectionTest();
+    Kernels_CommonPrefixTest();
+    Kernels_CommonSuffixTest();
+    Kernels_RunLengthTest();
+    exit(0);
+}
+
+std::vector<Kernels::Table> Kernels_Supported() {
+    std::vector<Kernels::Table> tables;
+    for (const auto& instructionSet :
+         { InstructionSet::SCALAR, InstructionSet::SSE2, InstructionSet::AVX2,
+           InstructionSet::AVX512 })
+        if (const auto table = Kernels::table(instructionSet))
+            tables.emplace_back(*table);
+    return tables;
+}
+
+std::vector<std::byte> Kernels_MakeBytes(const size_t& size) {
+    std::vector<std::byte> bytes(size);
+    for (size_t x = 0ULL; x < size; ++x)
+        bytes[x] = static_cast<std::byte>((x * 7ULL) % 251ULL);
+    return bytes;
+}
+
+void Kernels_SelectionTest() {
+    // Ensure scalar kernels are always available
+    assert(Kernels::supported(InstructionSet::SCALAR));
+    [[maybe_unused]] const auto scalar = Kernels::table(InstructionSet::SCALAR);
+    assert(
+        scalar && scalar->m_instructionSet == InstructionSet::SCALAR &&
+        scalar->m_commonPrefix && scalar->m_commonSuffix &&
+        scalar->m_runLength);
+
+    // Ensure unsupported instruction sets have no kernels
+    for ([[maybe_unused]] const auto& instructionSet :
+         { InstructionSet::SSE2, InstructionSet::AVX2, InstructionSet::AVX512 })
+        assert(
+            Kernels::supported(instructionSet) ==
+            Kernels::table(instructionSet).has_value());
+
+    // Ensure the fastest supported kernels are selected
+    const auto tables = Kernels_Supported();
+    assert(
+        Kernels::table().m_instructionSet ==
+        tables.back().m_instructionSet);
+}
+
+void Kernels_CommonPrefixTest() {
+    // Ensure every kernel finds the first mismatch, wherever it lands
+    const auto tables = Kernels_Supported();
+    const auto bytesA = Kernels_MakeBytes(512ULL);
+    for (size_t offset = 0ULL; offset < 8ULL; ++offset) {
+        for (size_t length = 0ULL; length <= 200ULL; ++length) {
+            for (size_t mismatch = 0ULL; mismatch <= length; ++mismatch) {
+                auto bytesB = bytesA;
+                bytesB[offset + mismatch] ^= std::byte{ 0x10 };
+                for ([[maybe_unused]] const auto& table : tables)
+                    assert(
+                        table.m_commonPrefix(
+                            &bytesA[offset], &bytesB[offset], length) ==
+                        mismatch);
+            }
+        }
+    }
+
+    // Ensure matching ranges are measured in full, even if empty
+    for ([[maybe_unused]] const auto& table : tables) {
+        assert(
+            table.m_commonPrefix(bytesA.data(), bytesA.data(), 0ULL) == 0ULL);
+        assert(
+            table.m_commonPrefix(bytesA.data(), bytesA.data(), 512ULL) ==
+            512ULL);
+    }
+}
+
+void Kernels_CommonSuffixTest() {
+    // Ensure every kernel finds the last mismatch, wherever it lands
+    const auto tables = Kernels_Supported();
+    const auto bytesA = Kernels_MakeBytes(512ULL);
+    for (size_t offset = 208ULL; offset < 216ULL; ++offset) {
+        for (size_t length = 0ULL; length <= 200ULL; ++length) {
+            for (size_t mismatch = 0ULL; mismatch <= length; ++mismatch) {
+                auto bytesB = bytesA;
+                bytesB[offset - mismatch - 1ULL] ^= std::byte{ 0x10 };
+                for ([[maybe_unused]] const auto& table : tables)
+                    assert(
+                        table.m_commonSuffix(
+                            &bytesA[offset], &bytesB[offset], length) ==
+                        mismatch);
+            }
+        }
+    }
+
+    // Ensure matching ranges are measured in full, even if empty
+    [[maybe_unused]] const auto end = bytesA.data() + bytesA.size();
+    for ([[maybe_unused]] const auto& table : tables) {
+        assert(table.m_commonSuffix(end, end, 0ULL) == 0ULL);
+        assert(table.m_commonSuffix(end, end, 512ULL) == 512ULL);
+    }
+}
+
+void Kernels_RunLengthTest() {
+    // Ensure every kernel finds the end of a run, for any value
+    const auto tables = Kernels_Supported();
+    for (const auto& value : { std::byte{ 0x00 }, std::byte{ 0xFF } }) {
+        for (size_t offset = 0ULL; offset < 8ULL; ++offset) {
+            for (size_t length = 0ULL; length <= 200ULL; ++length) {
+                for (size_t end = 0ULL; end <= length; ++end) {
+                    std::vector<std::byte> bytes(256ULL, value);
+                    bytes[offset + end] = std::byte{ 0x7F };
+                    for ([[maybe_unused]] const auto& table : tables)
+                        assert(
+                            table.m_runLength(&bytes[offset], value, length) ==
+                            end);
+                }
+            }
+        }
+    }
+
+    // Ensure empty runs are measured too
+    const auto bytes = Kernels_MakeBytes(64ULL);
+    for ([[maybe_unused]] const auto& table : tables) {
+        assert(table.m_runLength(bytes.data(), bytes[0], 0ULL) == 0ULL);
+        assert(table.m_runLength(bytes.data(), bytes[1], 64ULL) == 0ULL);
+        assert(table.m_runLength(bytes.data(), bytes[0], 64ULL) == 1ULL);
+    }
+}
\ No newline at end of file
@@ -92,6 +92,17 @@ void MemoryRange_MethodTest() {
     // Ensure we can hash the memory range
     assert(memRange.hash() != yatta::ZeroHash);
 
+    // Ensure a range of a single value has no entropy
+    assert(memRange.entropy() == 0.0);
+
+    // Ensure a range using all values equally has maximum entropy
+    const auto uniformBuffer = std::make_unique<std::byte[]>(8192ULL);
+    for (size_t x = 0ULL; x < 8192ULL; ++x)
+        uniformBuffer[x] = static_cast<std::byte>(x % 256ULL);
+    [[maybe_unused]] const MemoryRange uniformRange(
+        8192ULL, uniformBuffer.get());
+    assert(uniformRange.entropy() > 7.99 && uniformRange.entropy() <= 8.0);
+
     // Ensure we can return non-null array representations
     [[maybe_unused]] const auto charArray =
         static_cast<void*>(memRange.charArray());
@@ -275,7 +286,7 @@ void MemoryRange_InOutTypeExceptionTest() {
     // Ensure we can't write onto a null pointer
     [[maybe_unused]] bool exceptions[4] = { false };
     MemoryRange emptyRange;
-    size_t obj;
+    size_t obj(0ULL);
     try {
         // Throw Here
         emptyRange.in_type(obj);